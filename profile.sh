@@ -0,0 +1,64 @@
+#! /bin/bash
+#
+# Profile the planner under perf and draw flame graphs, one for the whole run and one per planner stage.
+# Builds the Profile configuration (optimized, with symbols and frame pointers) into build-profile and runs
+# batch_sim single threaded, so the profile is all planning and simulation with no socket noise.
+#
+#   ./profile.sh [batch_sim options...]      e.g. ./profile.sh --episodes 20 --traffic 30
+#
+# Needs perf, and Brendan Gregg's FlameGraph scripts (https://github.com/brendangregg/FlameGraph) either on
+# the PATH or in $FLAMEGRAPH_DIR. Without them it stops at perf's own report. CALL_GRAPH=dwarf gets deeper
+# stacks through inlined code at the cost of much bigger perf.data.
+#
+
+set -e
+
+cd "$(dirname "$0")"
+ROOT=$(pwd)
+BUILD_DIR=${BUILD_DIR:-build-profile}
+OUT_DIR=${OUT_DIR:-$BUILD_DIR/profile}
+CALL_GRAPH=${CALL_GRAPH:-fp}
+FREQUENCY=${FREQUENCY:-999}
+
+if ! command -v perf > /dev/null; then
+    echo "perf not found, install linux-tools for your kernel" >&2
+    exit 1
+fi
+
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Profile > /dev/null
+cmake --build "$BUILD_DIR" --target batch_sim -j"$(nproc)"
+
+mkdir -p "$OUT_DIR"
+ARGS=("$@")
+if [ ${#ARGS[@]} -eq 0 ]; then
+    ARGS=(--episodes 10)
+fi
+
+perf record -F "$FREQUENCY" --call-graph "$CALL_GRAPH" -o "$OUT_DIR/perf.data" \
+    "$BUILD_DIR/batch_sim" --threads 1 --map "$ROOT/data/highway_map.csv" "${ARGS[@]}"
+
+FLAMEGRAPH_DIR=${FLAMEGRAPH_DIR:-}
+STACKCOLLAPSE=$(command -v stackcollapse-perf.pl || echo "$FLAMEGRAPH_DIR/stackcollapse-perf.pl")
+FLAMEGRAPH=$(command -v flamegraph.pl || echo "$FLAMEGRAPH_DIR/flamegraph.pl")
+
+if [ ! -x "$STACKCOLLAPSE" ] || [ ! -x "$FLAMEGRAPH" ]; then
+    echo "FlameGraph scripts not found, set FLAMEGRAPH_DIR for flame graphs. perf's report instead:"
+    perf report -i "$OUT_DIR/perf.data" --stdio --no-children | head -60
+    exit 0
+fi
+
+perf script -i "$OUT_DIR/perf.data" | "$STACKCOLLAPSE" > "$OUT_DIR/stacks.folded"
+"$FLAMEGRAPH" --title "batch_sim" "$OUT_DIR/stacks.folded" > "$OUT_DIR/all.svg"
+
+# One graph per planner stage, only the stacks that went through it
+for STAGE in plan_path determine_lane_and_velocity generate_trajectory_for_lane Simulation::step; do
+    NAME=${STAGE//:/_}
+    if grep "$STAGE" "$OUT_DIR/stacks.folded" > "$OUT_DIR/$NAME.folded"; then
+        "$FLAMEGRAPH" --title "$STAGE" "$OUT_DIR/$NAME.folded" > "$OUT_DIR/$NAME.svg"
+    else
+        echo "No samples in $STAGE, inlined? Try CALL_GRAPH=dwarf"
+        rm -f "$OUT_DIR/$NAME.folded"
+    fi
+done
+
+echo "Flame graphs in $OUT_DIR"
@@ -0,0 +1,107 @@
+//
+// Counting operator new/delete and allocation reports, see AllocationTracker.h
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include "AllocationTracker.h"
+
+using namespace std;
+
+void AllocationStats::add(const AllocationCounts &tick) {
+    ticks++;
+    allocations += tick.allocations;
+    bytes += tick.bytes;
+    if (ticks > ALLOCATION_WARMUP_TICKS) {
+        steady_max = max(steady_max, tick.allocations);
+    }
+}
+
+void AllocationStats::merge(const AllocationStats &other) {
+    ticks += other.ticks;
+    allocations += other.allocations;
+    bytes += other.bytes;
+    steady_max = max(steady_max, other.steady_max);
+}
+
+static const char *STAGE_NAMES[NUM_ALLOCATION_STAGES] = {"decode", "decide", "trajectory", "encode"};
+
+void print_allocation_stats(ostream &out, const AllocationStats stats[NUM_ALLOCATION_STAGES]) {
+    if (!allocation_tracking_enabled()) {
+        out << "Allocations: not tracked, build with -DPLANNER_ALLOC_TRACKING=ON\n";
+        return;
+    }
+
+    out << "Allocations per tick:";
+    for (int stage = 0; stage < NUM_ALLOCATION_STAGES; stage++) {
+        const AllocationStats &stage_stats = stats[stage];
+        if (stage_stats.ticks == 0) {
+            continue;
+        }
+        out << " " << STAGE_NAMES[stage] << " " << (double) stage_stats.allocations / stage_stats.ticks << " ("
+            << stage_stats.bytes / stage_stats.ticks << " B, steady max " << stage_stats.steady_max << ")";
+    }
+    out << "\n";
+}
+
+uint64_t steady_state_allocations(const AllocationStats stats[NUM_ALLOCATION_STAGES]) {
+    uint64_t most = 0;
+    for (int stage = 0; stage < NUM_ALLOCATION_STAGES; stage++) {
+        most = max(most, stats[stage].steady_max);
+    }
+    return most;
+}
+
+#ifdef PLANNER_ALLOC_TRACKING
+
+// Plain thread locals, nothing to synchronize and nothing that allocates itself
+static thread_local AllocationCounts thread_counts;
+
+AllocationCounts allocation_counts() {
+    return thread_counts;
+}
+
+static void *counted_malloc(size_t size) {
+    thread_counts.allocations++;
+    thread_counts.bytes += size;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(size_t size) {
+    void *p = counted_malloc(size);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    return counted_malloc(size);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+    return counted_malloc(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept {
+    free(p);
+}
+
+#endif
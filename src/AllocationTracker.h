@@ -0,0 +1,89 @@
+//
+// Opt-in heap allocation counting, to see what one telemetry message costs in allocations at each stage
+// and hold the control loop to zero allocations once it's warmed up. Build with -DPLANNER_ALLOC_TRACKING=ON
+// to replace the global operator new/delete with counting versions. Otherwise everything here compiles
+// down to nothing, and the counts stay zero.
+//
+
+#ifndef PATH_PLANNING_ALLOCATION_TRACKER_H
+#define PATH_PLANNING_ALLOCATION_TRACKER_H
+
+#include <cstdint>
+#include <ostream>
+
+using namespace std;
+
+// Ticks to skip before counting towards steady_max, while vectors and caches are still growing
+static const uint64_t ALLOCATION_WARMUP_TICKS = 100;
+
+// Per message stages of the control loop
+enum AllocationStage {
+    STAGE_DECODE,     // JSON or binary telemetry to Telemetry
+    STAGE_DECIDE,     // determine_lane_and_velocity
+    STAGE_TRAJECTORY, // generate_trajectory_for_lane
+    STAGE_ENCODE,     // control reply serialization
+    NUM_ALLOCATION_STAGES
+};
+
+struct AllocationCounts {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+struct AllocationStats {
+    uint64_t ticks = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t steady_max = 0; // most allocations in one tick after the warm-up
+
+    void add(const AllocationCounts &tick);
+    void merge(const AllocationStats &other);
+};
+
+#ifdef PLANNER_ALLOC_TRACKING
+
+// Allocations made by the calling thread so far
+AllocationCounts allocation_counts();
+
+inline bool allocation_tracking_enabled() { return true; }
+
+inline AllocationCounts allocations_since(const AllocationCounts &start) {
+    AllocationCounts now = allocation_counts();
+    now.allocations -= start.allocations;
+    now.bytes -= start.bytes;
+    return now;
+}
+
+// Counts what's allocated between construction and destruction into stats
+class AllocationScope {
+    AllocationStats &stats;
+    AllocationCounts start;
+
+public:
+    explicit AllocationScope(AllocationStats &stats) : stats(stats), start(allocation_counts()) {}
+
+    ~AllocationScope() { stats.add(allocations_since(start)); }
+};
+
+#else
+
+inline AllocationCounts allocation_counts() { return AllocationCounts(); }
+
+inline bool allocation_tracking_enabled() { return false; }
+
+inline AllocationCounts allocations_since(const AllocationCounts &) { return AllocationCounts(); }
+
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocationStats &) {}
+};
+
+#endif
+
+// One line per stage: average allocations and bytes per tick, and the worst tick after warm-up
+void print_allocation_stats(ostream &out, const AllocationStats stats[NUM_ALLOCATION_STAGES]);
+
+// The most allocations any stage made in one tick after warm-up
+uint64_t steady_state_allocations(const AllocationStats stats[NUM_ALLOCATION_STAGES]);
+
+#endif //PATH_PLANNING_ALLOCATION_TRACKER_H
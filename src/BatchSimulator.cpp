@@ -0,0 +1,229 @@
+//
+// Batch evaluation of the planner: runs many simulated episodes in-process across all cores,
+// calling the planner directly (no sockets, no JSON), to see how a planner change does over
+// hours of driving in a few minutes.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AllocationTracker.h"
+#include "Config.h"
+#include "Horizon.h"
+#include "Map.h"
+#include "PathPlanner.h"
+#include "Simulation.h"
+#include "Telemetry.h"
+
+using namespace std;
+
+struct Options {
+    int episodes = 100;
+    int cars = 1;
+    int traffic = 12;
+    int steps = 3; // points driven between planner calls, like the simulator's latency
+    double seconds = 300; // simulated length of each episode, about one lap
+    int threads = max(1u, thread::hardware_concurrency());
+    unsigned int seed = 1; // episode i uses seed + i
+    string map_file = "../data/highway_map.csv";
+    Config config; // planner and lane settings, from --config
+    long max_allocs = -1; // fail if any stage allocates more than this in a tick after warm-up, -1 to not check
+    double accel_limit = -1; // m/s^2, fail if the car's total acceleration ever reaches this, -1 to not check
+    double jerk_limit = -1; // m/s^3, likewise for its total jerk
+};
+
+struct EpisodeResult {
+    unsigned int seed;
+    double miles = 0;
+    int collisions = 0;
+    int speeding_steps = 0;
+    int out_of_lane_steps = 0;
+    int starved_steps = 0;
+    double max_accel = 0;
+    double max_jerk = 0;
+    long plan_calls = 0;
+    double plan_seconds = 0;
+    AllocationStats allocations[NUM_ALLOCATION_STAGES];
+    HorizonStats horizon;
+
+    bool has_incident() const { return collisions > 0 || speeding_steps > 0 || out_of_lane_steps > 0; }
+};
+
+static Options parse_options(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string name = argv[i];
+        string value = argv[i + 1];
+        if (name == "--episodes") {
+            options.episodes = max(1, stoi(value));
+        } else if (name == "--cars") {
+            options.cars = max(1, stoi(value));
+        } else if (name == "--traffic") {
+            options.traffic = max(0, stoi(value));
+        } else if (name == "--steps") {
+            options.steps = max(1, stoi(value));
+        } else if (name == "--seconds") {
+            options.seconds = max(1., stod(value));
+        } else if (name == "--threads") {
+            options.threads = max(1, stoi(value));
+        } else if (name == "--seed") {
+            options.seed = stoul(value);
+        } else if (name == "--map") {
+            options.map_file = value;
+        } else if (name == "--max-allocs") {
+            options.max_allocs = stol(value);
+        } else if (name == "--accel-limit") {
+            options.accel_limit = stod(value);
+        } else if (name == "--jerk-limit") {
+            options.jerk_limit = stod(value);
+        } else if (name == "--config") {
+            if (!load_config(value, options.config) || !validate_config(options.config)) {
+                exit(1);
+            }
+        } else {
+            cerr << "Unknown option " << name << endl;
+        }
+    }
+    return options;
+}
+
+static EpisodeResult run_episode(const Map &map, const Options &options, unsigned int seed) {
+    Simulation sim(map, options.cars, options.traffic, seed);
+    vector<PlannerState> planners(options.cars);
+    for (PlannerState &planner : planners) {
+        planner.config = options.config.planner;
+    }
+    Telemetry telemetry;
+
+    EpisodeResult result;
+    result.seed = seed;
+
+    int rounds = (int) (options.seconds / (SIMULATOR_TIME_STEP * options.steps));
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < options.cars; i++) {
+            sim.telemetry(i, telemetry);
+
+            auto started = chrono::steady_clock::now();
+            const pair<vector<double>, vector<double>> &path = plan_path(map, telemetry, planners[i]);
+            result.plan_seconds += chrono::duration<double>(chrono::steady_clock::now() - started).count();
+            result.plan_calls++;
+
+            sim.control(i, path.first, path.second);
+        }
+
+        for (int k = 0; k < options.steps; k++) {
+            sim.step();
+        }
+    }
+
+    for (int i = 0; i < options.cars; i++) {
+        const EgoCar &ego = sim.ego(i);
+        result.miles += ego.distance / 1609.34;
+        result.collisions += ego.collisions;
+        result.speeding_steps += ego.speeding_steps;
+        result.out_of_lane_steps += ego.out_of_lane_steps;
+        result.starved_steps += ego.starved_steps;
+        result.max_accel = max(result.max_accel, ego.max_accel);
+        result.max_jerk = max(result.max_jerk, ego.max_jerk);
+        for (int stage = 0; stage < NUM_ALLOCATION_STAGES; stage++) {
+            result.allocations[stage].merge(planners[i].allocations[stage]);
+        }
+        result.horizon.merge(planners[i].horizon.stats);
+    }
+
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parse_options(argc, argv);
+
+    Map map;
+    if (!map.load_map(options.map_file, options.config.num_lanes, options.config.lane_width)) {
+        return 1;
+    }
+
+    vector<EpisodeResult> results(options.episodes);
+    atomic<int> next_episode(0);
+
+    auto started = chrono::steady_clock::now();
+
+    // Every worker keeps taking the next episode until they're all done
+    vector<thread> workers;
+    for (int t = 0; t < min(options.threads, options.episodes); t++) {
+        workers.emplace_back([&]() {
+            for (int e = next_episode++; e < options.episodes; e = next_episode++) {
+                results[e] = run_episode(map, options, options.seed + e);
+            }
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+
+    double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    EpisodeResult total;
+    int incidents = 0;
+    for (const EpisodeResult &result : results) {
+        total.miles += result.miles;
+        total.collisions += result.collisions;
+        total.speeding_steps += result.speeding_steps;
+        total.out_of_lane_steps += result.out_of_lane_steps;
+        total.starved_steps += result.starved_steps;
+        total.max_accel = max(total.max_accel, result.max_accel);
+        total.max_jerk = max(total.max_jerk, result.max_jerk);
+        total.plan_calls += result.plan_calls;
+        total.plan_seconds += result.plan_seconds;
+        for (int stage = 0; stage < NUM_ALLOCATION_STAGES; stage++) {
+            total.allocations[stage].merge(result.allocations[stage]);
+        }
+        total.horizon.merge(result.horizon);
+        if (result.has_incident()) {
+            incidents++;
+        }
+    }
+
+    double simulated_seconds = options.episodes * options.cars * options.seconds;
+    cout << options.episodes << " episodes of " << options.cars << " car(s) on " << workers.size() << " threads: "
+         << simulated_seconds / 3600 << " h driven in " << wall_seconds << " s ("
+         << simulated_seconds / max(wall_seconds, 1e-9) << "x real time)\n";
+    cout << "Planner: " << total.plan_calls << " calls, "
+         << total.plan_seconds / max(total.plan_calls, 1L) * 1e6 << " us per call\n";
+    cout << "Driving: " << total.miles << " miles, " << total.collisions << " collisions, "
+         << total.speeding_steps << " speeding steps, " << total.out_of_lane_steps << " out of lane steps, "
+         << total.starved_steps << " starved steps, max accel " << total.max_accel << " m/s^2, max jerk "
+         << total.max_jerk << " m/s^3\n";
+    cout << incidents << " episodes with incidents";
+
+    // Seeds to rerun the bad ones with
+    int listed = 0;
+    for (const EpisodeResult &result : results) {
+        if (result.has_incident() && listed++ < 10) {
+            cout << (listed == 1 ? ", seeds: " : ", ") << result.seed;
+        }
+    }
+    cout << endl;
+
+    print_horizon_stats(cout, total.horizon);
+    print_allocation_stats(cout, total.allocations);
+    if (options.max_allocs >= 0 && allocation_tracking_enabled()
+        && steady_state_allocations(total.allocations) > (uint64_t) options.max_allocs) {
+        cout << "FAILED: more than " << options.max_allocs << " allocations in a tick after warm-up" << endl;
+        return 1;
+    }
+    if (options.accel_limit >= 0 && total.max_accel >= options.accel_limit) {
+        cout << "FAILED: total acceleration reached " << options.accel_limit << " m/s^2" << endl;
+        return 1;
+    }
+    if (options.jerk_limit >= 0 && total.max_jerk >= options.jerk_limit) {
+        cout << "FAILED: total jerk reached " << options.jerk_limit << " m/s^3" << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+//
+// Config file and command line parsing, see Config.h
+//
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "Config.h"
+#include "LaneGeometry.h"
+
+using namespace std;
+
+void read_config(const json &j, Config &config) {
+    config.port = j.value("port", config.port);
+    config.map_file = j.value("map_file", config.map_file);
+    config.map_reload_seconds = j.value("map_reload_seconds", config.map_reload_seconds);
+    config.fleet_workers = j.value("fleet_workers", config.fleet_workers);
+    config.num_lanes = j.value("num_lanes", config.num_lanes);
+    config.lane_width = j.value("lane_width", config.lane_width);
+    config.planner.max_speed = j.value("max_speed", config.planner.max_speed);
+    config.planner.max_accel = j.value("max_accel", config.planner.max_accel);
+    config.planner.max_jerk = j.value("max_jerk", config.planner.max_jerk);
+    config.planner.num_points = j.value("num_points", config.planner.num_points);
+    config.planner.min_points = j.value("min_points", config.planner.min_points);
+    config.planner.latency_budget_ms = j.value("latency_budget_ms", config.planner.latency_budget_ms);
+    config.planner.target_distance = j.value("target_distance", config.planner.target_distance);
+}
+
+json write_config(const Config &config) {
+    json j;
+    j["port"] = config.port;
+    j["map_file"] = config.map_file;
+    j["map_reload_seconds"] = config.map_reload_seconds;
+    j["fleet_workers"] = config.fleet_workers;
+    j["num_lanes"] = config.num_lanes;
+    j["lane_width"] = config.lane_width;
+    j["max_speed"] = config.planner.max_speed;
+    j["max_accel"] = config.planner.max_accel;
+    j["max_jerk"] = config.planner.max_jerk;
+    j["num_points"] = config.planner.num_points;
+    j["min_points"] = config.planner.min_points;
+    j["latency_budget_ms"] = config.planner.latency_budget_ms;
+    j["target_distance"] = config.planner.target_distance;
+    return j;
+}
+
+bool load_config(const string &file, Config &config) {
+    ifstream in(file.c_str());
+    if (!in) {
+        cerr << "Could not open config file " << file << endl;
+        return false;
+    }
+
+    try {
+        json j;
+        in >> j;
+        read_config(j, config);
+    } catch (const exception &e) {
+        cerr << "Could not read config file " << file << ": " << e.what() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool parse_config_args(int argc, char *argv[], Config &config) {
+    // The file goes first wherever it is on the command line, so the other options override it
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && !load_config(argv[i + 1], config)) {
+            return false;
+        }
+    }
+
+    bool min_points_given = false;
+    for (int i = 1; i < argc; i += 2) {
+        string name = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << name << endl;
+            return false;
+        }
+        string value = argv[i + 1];
+
+        try {
+            if (name == "--config") {
+                continue;
+            } else if (name == "--port") {
+                config.port = stoi(value);
+            } else if (name == "--map") {
+                config.map_file = value;
+            } else if (name == "--map-reload") {
+                config.map_reload_seconds = stod(value);
+            } else if (name == "--fleet") {
+                config.fleet_workers = stoi(value);
+            } else if (name == "--lanes") {
+                config.num_lanes = stoi(value);
+            } else if (name == "--lane-width") {
+                config.lane_width = stod(value);
+            } else if (name == "--max-speed") {
+                config.planner.max_speed = stod(value);
+            } else if (name == "--max-accel") {
+                config.planner.max_accel = stod(value);
+            } else if (name == "--max-jerk") {
+                config.planner.max_jerk = stod(value);
+            } else if (name == "--points") {
+                config.planner.num_points = stoi(value);
+            } else if (name == "--min-points") {
+                config.planner.min_points = stoi(value);
+                min_points_given = true;
+            } else if (name == "--latency-budget") {
+                config.planner.latency_budget_ms = stod(value);
+            } else if (name == "--target-distance") {
+                config.planner.target_distance = stod(value);
+            } else {
+                cerr << "Unknown option " << name << endl;
+                return false;
+            }
+        } catch (const exception &e) {
+            cerr << "Bad value " << value << " for " << name << endl;
+            return false;
+        }
+    }
+
+    // A shorter path on its own brings the shortest one down with it, only both set explicitly can conflict
+    if (!min_points_given) {
+        config.planner.min_points = min(config.planner.min_points, config.planner.num_points);
+    }
+
+    return validate_config(config);
+}
+
+bool validate_config(const Config &config) {
+    const char *problem = nullptr;
+    if (config.port <= 0 || config.port > 65535) {
+        problem = "port must be 1-65535";
+    } else if (config.map_reload_seconds < 0) {
+        problem = "map_reload_seconds can't be negative";
+    } else if (config.fleet_workers < 0) {
+        problem = "fleet_workers can't be negative";
+    } else if (config.num_lanes < MIN_LANES || config.num_lanes > MAX_LANES) {
+        problem = "num_lanes must be 2-6";
+    } else if (config.lane_width <= 0) {
+        problem = "lane_width must be positive";
+    } else if (config.planner.max_speed <= 0 || config.planner.max_accel <= 0 || config.planner.max_jerk <= 0) {
+        problem = "max_speed, max_accel and max_jerk must be positive";
+    } else if (config.planner.num_points < 2) {
+        problem = "num_points must be at least 2";
+    } else if (config.planner.min_points < 2 || config.planner.min_points > config.planner.num_points) {
+        problem = "min_points (--min-points) must be between 2 and num_points (--points)";
+    } else if (config.planner.latency_budget_ms < 0) {
+        problem = "latency_budget_ms can't be negative";
+    } else if (config.planner.target_distance <= 0) {
+        problem = "target_distance must be positive";
+    }
+
+    if (problem) {
+        cerr << "Bad config: " << problem << endl;
+        return false;
+    }
+    return true;
+}
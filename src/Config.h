@@ -0,0 +1,49 @@
+//
+// Everything tunable per deployment, read at startup from a JSON config file (`--config <file>`) and then
+// command line overrides, so latency vs. horizon trade-offs don't need a rebuild. Any key left out keeps
+// its default, see data/planner_config.json for all of them.
+//
+
+#ifndef PATH_PLANNING_CONFIG_H
+#define PATH_PLANNING_CONFIG_H
+
+#include <string>
+#include "Map.h"
+#include "PathPlanner.h"
+#include "Json.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+struct Config {
+    int port = 4567;
+    string map_file = "../data/highway_map.csv";
+    double map_reload_seconds = 1; // how often to check the map file for changes, 0 to never reload
+    int fleet_workers = 0; // planning threads, 0 to drive the one simulator car inline
+
+    int num_lanes = NUM_LANES;
+    double lane_width = LANE_WIDTH;
+
+    PlannerConfig planner;
+};
+
+// Read the keys present in a config JSON object into config, leaving the rest as they are, throws on a key
+// of the wrong type
+void read_config(const json &j, Config &config);
+
+// All of config as a JSON object, in the same format
+json write_config(const Config &config);
+
+// Read the keys present in a JSON config file into config, false (and a message on cerr) if it can't
+bool load_config(const string &file, Config &config);
+
+// Apply `--config <file>` first, then any overrides: --port, --map, --map-reload, --fleet, --lanes, --lane-width,
+// --max-speed, --max-accel, --max-jerk, --points, --min-points, --latency-budget and --target-distance.
+// Unless --min-points is given too, min_points comes down to num_points if that's fewer. Returns false on anything it doesn't understand or a value out of range.
+bool parse_config_args(int argc, char *argv[], Config &config);
+
+// false (and a message on cerr) for values the planner can't work with
+bool validate_config(const Config &config);
+
+#endif //PATH_PLANNING_CONFIG_H
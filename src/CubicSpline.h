@@ -0,0 +1,127 @@
+//
+// Cubic spline through up to MaxPoints points, fitted and evaluated exactly the way tk::spline does with its
+// default (natural) boundary conditions or a given slope at the first point, but in fixed-size storage:
+// tk::spline allocates its band matrix and half a dozen vectors on every set_points, which the trajectory
+// stage does whenever it refits.
+//
+
+#ifndef PATH_PLANNING_CUBIC_SPLINE_H
+#define PATH_PLANNING_CUBIC_SPLINE_H
+
+#include <algorithm>
+
+template<int MaxPoints>
+class CubicSpline {
+    static_assert(MaxPoints >= 3, "A cubic spline needs at least three points");
+
+    int n = 0;
+    double m_x[MaxPoints];
+    double m_y[MaxPoints];
+    double m_a[MaxPoints]; // f_i(x) = a_i * h^3 + b_i * h^2 + c_i * h + y_i, h = x - x_i
+    double m_b[MaxPoints];
+    double m_c[MaxPoints];
+
+public:
+    // count points with x strictly increasing, between 3 and MaxPoints of them, zero second derivative at both ends
+    void set_points(const double *x, const double *y, int count) {
+        fit(x, y, count, false, 0.);
+    }
+
+    // The same, but starting out with the given slope rather than a zero second derivative
+    void set_points(const double *x, const double *y, int count, double left_slope) {
+        fit(x, y, count, true, left_slope);
+    }
+
+    double operator()(double x) const {
+        int idx = segment(x);
+        double h = x - m_x[idx];
+        if (x < m_x[0]) {
+            return (m_b[0] * h + m_c[0]) * h + m_y[0];
+        } else if (x > m_x[n - 1]) {
+            return (m_b[n - 1] * h + m_c[n - 1]) * h + m_y[n - 1];
+        }
+        return ((m_a[idx] * h + m_b[idx]) * h + m_c[idx]) * h + m_y[idx];
+    }
+
+    // First and second derivatives, the beginning and end carrying on as parabolas the way operator() does
+    double derivative(double x) const {
+        int idx = segment(x);
+        double h = x - m_x[idx];
+        double a = x < m_x[0] ? 0. : m_a[idx];
+        return (3.0 * a * h + 2.0 * m_b[idx]) * h + m_c[idx];
+    }
+
+    double second_derivative(double x) const {
+        int idx = segment(x);
+        double h = x - m_x[idx];
+        double a = x < m_x[0] ? 0. : m_a[idx];
+        return 6.0 * a * h + 2.0 * m_b[idx];
+    }
+
+private:
+    // Closest point at or before x, the first one even if x is before that
+    int segment(double x) const {
+        return std::max((int) (std::lower_bound(m_x, m_x + n, x) - m_x) - 1, 0);
+    }
+
+    void fit(const double *x, const double *y, int count, bool clamped, double left_slope) {
+        n = std::min(count, MaxPoints);
+        std::copy(x, x + n, m_x);
+        std::copy(y, y + n, m_y);
+
+        // Tridiagonal system for b, lower, diagonal and upper bands, the first row replaced when clamped
+        double lower[MaxPoints] = {};
+        double diag[MaxPoints] = {};
+        double upper[MaxPoints] = {};
+        double rhs[MaxPoints] = {};
+        for (int i = 1; i < n - 1; i++) {
+            lower[i] = 1.0 / 3.0 * (x[i] - x[i - 1]);
+            diag[i] = 2.0 / 3.0 * (x[i + 1] - x[i - 1]);
+            upper[i] = 1.0 / 3.0 * (x[i + 1] - x[i]);
+            rhs[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]);
+        }
+        diag[0] = 2.0;
+        if (clamped) {
+            diag[0] = 2.0 * (x[1] - x[0]);
+            upper[0] = 1.0 * (x[1] - x[0]);
+            rhs[0] = 3.0 * ((y[1] - y[0]) / (x[1] - x[0]) - left_slope);
+        }
+        diag[n - 1] = 2.0;
+
+        // LU decomposition the way tk::band_matrix does it, rows scaled to a unit diagonal first
+        double saved_diag[MaxPoints];
+        for (int i = 0; i < n; i++) {
+            saved_diag[i] = 1.0 / diag[i];
+            lower[i] *= saved_diag[i];
+            upper[i] *= saved_diag[i];
+            diag[i] = 1.0;
+        }
+        for (int k = 0; k + 1 < n; k++) {
+            double factor = -lower[k + 1] / diag[k];
+            lower[k + 1] = -factor;
+            diag[k + 1] = diag[k + 1] + factor * upper[k];
+        }
+        double solved[MaxPoints];
+        for (int i = 0; i < n; i++) {
+            double sum = i > 0 ? lower[i] * solved[i - 1] : 0;
+            solved[i] = rhs[i] * saved_diag[i] - sum;
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            double sum = i + 1 < n ? upper[i] * m_b[i + 1] : 0;
+            m_b[i] = (solved[i] - sum) / diag[i];
+        }
+
+        for (int i = 0; i < n - 1; i++) {
+            m_a[i] = 1.0 / 3.0 * (m_b[i + 1] - m_b[i]) / (x[i + 1] - x[i]);
+            m_c[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i])
+                     - 1.0 / 3.0 * (2.0 * m_b[i] + m_b[i + 1]) * (x[i + 1] - x[i]);
+        }
+
+        // Carries on as a parabola past the last point, with the slope it ends on
+        double h = x[n - 1] - x[n - 2];
+        m_a[n - 1] = 0.0;
+        m_c[n - 1] = 3.0 * m_a[n - 2] * h * h + 2.0 * m_b[n - 2] * h + m_c[n - 2];
+    }
+};
+
+#endif //PATH_PLANNING_CUBIC_SPLINE_H
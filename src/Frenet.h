@@ -0,0 +1,79 @@
+//
+// Wrap-aware arithmetic on the s coordinate of a closed track, so comparisons keep working
+// when s rolls over from the track length back to 0.
+//
+
+#ifndef PATH_PLANNING_FRENET_H
+#define PATH_PLANNING_FRENET_H
+
+#include <math.h>
+
+// Bring s into [0, track_length)
+inline double wrap_s(double s, double track_length) {
+    if (s >= 0 && s < track_length) {
+        return s; // by far the common case, skip the fmod
+    }
+
+    s = fmod(s, track_length);
+    if (s < 0) {
+        s += track_length;
+    }
+
+    return s;
+}
+
+// Signed distance along the track going from `from` to `to`, taking the shorter way around,
+// so a car just past the seam is still a few meters ahead rather than a whole lap behind.
+inline double s_diff(double to, double from, double track_length) {
+    double diff = wrap_s(to - from, track_length);
+    if (diff > track_length / 2) {
+        diff -= track_length;
+    }
+
+    return diff;
+}
+
+// Whether s lies within [start, start + length) going forward along the track
+inline bool s_in_window(double s, double start, double length, double track_length) {
+    return wrap_s(s - start, track_length) < length;
+}
+
+// Closest point to (x, y) on the straight map segment from (x0, y0) to (x1, y1)
+struct SegmentProjection {
+    double t;       // where along the segment, 0 at its start and 1 at its end
+    double length2; // squared length of the segment
+    double dist2;   // squared distance from (x, y) to the closest point
+    double cross;   // positive when (x, y) is left of the direction of travel
+};
+
+inline SegmentProjection project_onto_segment(double x0, double y0, double x1, double y1, double x, double y) {
+    double n_x = x1 - x0;
+    double n_y = y1 - y0;
+    double x_x = x - x0;
+    double x_y = y - y0;
+
+    SegmentProjection projection;
+    projection.length2 = n_x * n_x + n_y * n_y;
+    double t = projection.length2 > 0 ? (x_x * n_x + x_y * n_y) / projection.length2 : 0;
+    projection.t = t < 0 ? 0 : (t > 1 ? 1 : t);
+
+    double e_x = x_x - projection.t * n_x;
+    double e_y = x_y - projection.t * n_y;
+    projection.dist2 = e_x * e_x + e_y * e_y;
+    projection.cross = n_x * x_y - n_y * x_x;
+
+    return projection;
+}
+
+// s of the projected point, given s at the segment's start
+inline double projection_s(const SegmentProjection &projection, double s0) {
+    return s0 + projection.t * sqrt(projection.length2);
+}
+
+// d of (x, y), positive to the right of the direction of travel like getXY's
+inline double projection_d(const SegmentProjection &projection) {
+    double d = sqrt(projection.dist2);
+    return projection.cross > 0 ? -d : d;
+}
+
+#endif //PATH_PLANNING_FRENET_H
@@ -0,0 +1,36 @@
+//
+// Frenet conversion for one car's successive positions. A car only moves on a few meters between
+// conversions, so starting from the map segment it was last on means checking a couple of neighboring
+// segments rather than the whole map. Teleports, the first position and a reloaded map still get the
+// full search.
+//
+
+#ifndef PATH_PLANNING_FRENET_TRACKER_H
+#define PATH_PLANNING_FRENET_TRACKER_H
+
+#include <cstdint>
+#include <utility>
+#include "Map.h"
+
+using namespace std;
+
+class FrenetTracker {
+
+private:
+    int segment = -1; // map segment of the last position, -1 before the first one
+    uint64_t map_generation = 0;
+
+public:
+    pair<double, double> getFrenet(const Map &map, double x, double y) {
+        // Segment indexes mean nothing on another map
+        if (map_generation != map.get_generation()) {
+            map_generation = map.get_generation();
+            segment = -1;
+        }
+        return map.getFrenetNear(segment, x, y);
+    }
+
+    void reset() { segment = -1; }
+};
+
+#endif //PATH_PLANNING_FRENET_TRACKER_H
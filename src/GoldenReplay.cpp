@@ -0,0 +1,474 @@
+//
+// Golden trajectories: records what the planner answers to a drive through the in-process simulation, and
+// replays those telemetry messages later to check a refactored planner still answers the same, point for
+// point within a tolerance. The recording is the websocket traffic itself, one socket.io frame per line
+// (a header line, then each telemetry frame followed by the control frame sent back), gzipped.
+//
+//   golden_replay record <corpus.jsonl.gz> [--map <csv>] [--config <json>] [--seed <n>] [--traffic <cars>]
+//                 [--steps <n>] [--seconds <s>] [--planner <command>]
+//   golden_replay check [<corpus.jsonl.gz>...] [--map <csv>] [--tolerance <m>] [--planner <command>]
+//
+// The map and, for check, the corpus default to the ones in the source tree's data directory, wherever it's run from.
+// --planner swaps this build's planner for another program, a build of an older commit say, that reads telemetry
+// frames one per line on stdin and answers each with a control frame line on stdout, fresh for every corpus file.
+// Messages are replayed as recorded, not driven again, so a path that comes out different doesn't change
+// the telemetry after it and every mismatch is reported against the message that caused it.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "Config.h"
+#include "Map.h"
+#include "PathPlanner.h"
+#include "Protocol.h"
+#include "Simulation.h"
+#include "Telemetry.h"
+
+using namespace std;
+
+static const int GOLDEN_VERSION = 1;
+static const double GOLDEN_TOLERANCE = 1e-6; // meters, well under what a different rounding could move a point
+static const int GOLDEN_REPORTED_MISMATCHES = 10;
+
+// Set by CMake to the source tree's data directory
+#ifndef PLANNER_DATA_DIR
+#define PLANNER_DATA_DIR "../data"
+#endif
+static const char *GOLDEN_CORPUS[] = {PLANNER_DATA_DIR "/golden/light_traffic.jsonl.gz",
+                                      PLANNER_DATA_DIR "/golden/dense_traffic.jsonl.gz"};
+
+struct Options {
+    string map_file = PLANNER_DATA_DIR "/highway_map.csv";
+    Config config;
+    unsigned int seed = 1;
+    int traffic = 12;
+    int steps = 3;
+    double seconds = 30;
+    double tolerance = GOLDEN_TOLERANCE;
+    string planner_command; // empty for the planner built in
+    vector<string> corpus_files;
+};
+
+// One line without its newline into line, false at the end of the file
+static bool read_line(gzFile in, string &line) {
+    line.clear();
+    char buffer[4096];
+    while (gzgets(in, buffer, sizeof(buffer)) != nullptr) {
+        line += buffer;
+        if (line.back() == '\n') {
+            line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+static void write_line(gzFile out, const string &line) {
+    gzwrite(out, line.data(), (unsigned int) line.size());
+    gzputc(out, '\n');
+}
+
+// The data object of a socket.io event frame, 42["<event>",{...}]
+static bool parse_event(const string &frame, const string &event, json &data) {
+    if (frame.compare(0, 2, "42") != 0) {
+        return false;
+    }
+    try {
+        json j = json::parse(frame.substr(2));
+        if (!j.is_array() || j.size() != 2 || j[0] != event) {
+            return false;
+        }
+        data = j[1];
+    } catch (const exception &e) {
+        return false;
+    }
+    return true;
+}
+
+// Plans the path for telemetry the way path_planning does and serializes the control frame
+static void plan_frame(const Map &map, const Telemetry &telemetry, PlannerState &planner, string &frame) {
+    const pair<vector<double>, vector<double>> &path = plan_path(map, telemetry, planner);
+    write_control_frame(frame, path.first, path.second);
+}
+
+// Another planner program behind a pair of pipes, see --planner
+class ExternalPlanner {
+    pid_t pid = -1;
+    FILE *to_planner = nullptr;
+    FILE *from_planner = nullptr;
+
+public:
+    ExternalPlanner() = default;
+    ExternalPlanner(const ExternalPlanner &) = delete;
+    ExternalPlanner &operator=(const ExternalPlanner &) = delete;
+
+    ~ExternalPlanner() {
+        if (to_planner != nullptr) {
+            fclose(to_planner);
+        }
+        if (from_planner != nullptr) {
+            fclose(from_planner);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    // Runs command through the shell
+    bool start(const string &command) {
+        // A planner that dies shows up as it not answering, not as this dying writing to it
+        signal(SIGPIPE, SIG_IGN);
+        int input[2];
+        int output[2];
+        if (pipe(input) != 0) {
+            cerr << "Could not create a pipe for " << command << endl;
+            return false;
+        }
+        if (pipe(output) != 0) {
+            close(input[0]);
+            close(input[1]);
+            cerr << "Could not create a pipe for " << command << endl;
+            return false;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            dup2(input[0], STDIN_FILENO);
+            dup2(output[1], STDOUT_FILENO);
+            close(input[0]);
+            close(input[1]);
+            close(output[0]);
+            close(output[1]);
+            execl("/bin/sh", "sh", "-c", command.c_str(), (char *) nullptr);
+            _exit(127);
+        }
+        close(input[0]);
+        close(output[1]);
+        if (pid < 0) {
+            close(input[1]);
+            close(output[0]);
+            cerr << "Could not start " << command << endl;
+            return false;
+        }
+        to_planner = fdopen(input[1], "w");
+        from_planner = fdopen(output[0], "r");
+        return to_planner != nullptr && from_planner != nullptr;
+    }
+
+    // The control frame for a telemetry frame, false if the planner didn't answer
+    bool plan(const string &telemetry_frame, string &frame) {
+        if (fputs(telemetry_frame.c_str(), to_planner) == EOF || fputc('\n', to_planner) == EOF
+            || fflush(to_planner) != 0) {
+            return false;
+        }
+        frame.clear();
+        char buffer[4096];
+        while (fgets(buffer, sizeof(buffer), from_planner) != nullptr) {
+            frame += buffer;
+            if (frame.back() == '\n') {
+                frame.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static PlannerState replay_planner(const Config &config) {
+    PlannerState planner;
+    planner.config = config.planner;
+    // Planning time depends on the machine, the paths mustn't
+    planner.horizon.timed = false;
+    return planner;
+}
+
+static bool record(const string &file, const Options &options) {
+    Map map;
+    if (!map.load_map(options.map_file, options.config.num_lanes, options.config.lane_width)) {
+        return false;
+    }
+
+    gzFile out = gzopen(file.c_str(), "wb9");
+    if (out == nullptr) {
+        cerr << "Could not write " << file << endl;
+        return false;
+    }
+
+    json header;
+    header["golden"] = GOLDEN_VERSION;
+    header["seed"] = options.seed;
+    header["traffic"] = options.traffic;
+    header["steps"] = options.steps;
+    header["seconds"] = options.seconds;
+    header["config"] = write_config(options.config);
+    write_line(out, header.dump());
+
+    ExternalPlanner external;
+    if (!options.planner_command.empty() && !external.start(options.planner_command)) {
+        gzclose(out);
+        return false;
+    }
+
+    Simulation sim(map, 1, options.traffic, options.seed);
+    PlannerState planner = replay_planner(options.config);
+    Telemetry telemetry;
+    Telemetry decoded;
+    string frame;
+    int lane_changes = 0;
+    int following = 0; // messages slowed down for a car ahead
+
+    int rounds = (int) (options.seconds / (SIMULATOR_TIME_STEP * options.steps));
+    for (int round = 0; round < rounds; round++) {
+        sim.telemetry(0, telemetry);
+        string telemetry_frame = "42[\"telemetry\"," + encode_telemetry(telemetry).dump() + "]";
+
+        if (!options.planner_command.empty()) {
+            if (!external.plan(telemetry_frame, frame)) {
+                cerr << options.planner_command << " didn't answer message " << round + 1 << endl;
+                gzclose(out);
+                return false;
+            }
+        } else {
+            // Plan from the frame as it's written, so replaying it sees exactly the same numbers
+            json data;
+            parse_event(telemetry_frame, "telemetry", data);
+            decode_telemetry(data, decoded);
+            int lane = planner.lane;
+            plan_frame(map, decoded, planner, frame);
+            lane_changes += planner.lane != lane;
+            following += planner.target_velocity < planner.config.max_speed;
+        }
+
+        write_line(out, telemetry_frame);
+        write_line(out, frame);
+
+        json control;
+        try {
+            if (!parse_event(frame, "control", control)) {
+                throw runtime_error("not a control frame");
+            }
+            sim.control(0, control["next_x"].get<vector<double>>(), control["next_y"].get<vector<double>>());
+        } catch (const exception &e) {
+            cerr << "Bad answer to message " << round + 1 << ": " << e.what() << endl;
+            gzclose(out);
+            return false;
+        }
+        for (int k = 0; k < options.steps; k++) {
+            sim.step();
+        }
+    }
+
+    gzclose(out);
+    const EgoCar &ego = sim.ego(0);
+    cout << "Recorded " << rounds << " messages to " << file << ": " << ego.distance / 1609.34 << " miles, ";
+    // Only known from the inside
+    if (options.planner_command.empty()) {
+        cout << lane_changes << " lane changes, " << following << " messages following a car, ";
+    }
+    cout << ego.collisions << " collisions" << endl;
+    return true;
+}
+
+static bool check(const string &file, const Options &options) {
+    gzFile in = gzopen(file.c_str(), "rb");
+    if (in == nullptr) {
+        cerr << "Could not open " << file << endl;
+        return false;
+    }
+
+    string line;
+    json header;
+    try {
+        if (!read_line(in, line)) {
+            throw runtime_error("empty file");
+        }
+        header = json::parse(line);
+        if (header.value("golden", 0) != GOLDEN_VERSION) {
+            throw runtime_error("not a version " + to_string(GOLDEN_VERSION) + " golden file");
+        }
+    } catch (const exception &e) {
+        cerr << file << ": " << e.what() << endl;
+        gzclose(in);
+        return false;
+    }
+
+    Config config;
+    read_config(header["config"], config);
+    Map map;
+    if (!map.load_map(options.map_file, config.num_lanes, config.lane_width)) {
+        gzclose(in);
+        return false;
+    }
+
+    ExternalPlanner external;
+    if (!options.planner_command.empty() && !external.start(options.planner_command)) {
+        gzclose(in);
+        return false;
+    }
+
+    PlannerState planner = replay_planner(config);
+    Telemetry telemetry;
+    string frame;
+    string expected_frame;
+    json data;
+
+    int messages = 0;
+    int mismatches = 0;
+    double max_error = 0;
+    bool readable = true;
+    while (read_line(in, line)) {
+        if (!read_line(in, expected_frame) || !parse_event(line, "telemetry", data)) {
+            readable = false;
+            break;
+        }
+        messages++;
+
+        // A message that doesn't decode or plan is as different as it gets, the rest can still be checked
+        vector<double> expected_x;
+        vector<double> expected_y;
+        vector<double> actual_x;
+        vector<double> actual_y;
+        try {
+            if (!options.planner_command.empty()) {
+                if (!external.plan(line, frame)) {
+                    throw runtime_error("no answer from " + options.planner_command);
+                }
+            } else {
+                decode_telemetry(data, telemetry);
+                plan_frame(map, telemetry, planner, frame);
+            }
+
+            json expected;
+            json actual;
+            if (!parse_event(expected_frame, "control", expected) || !parse_event(frame, "control", actual)) {
+                throw runtime_error("not a control frame");
+            }
+            expected_x = expected["next_x"].get<vector<double>>();
+            expected_y = expected["next_y"].get<vector<double>>();
+            actual_x = actual["next_x"].get<vector<double>>();
+            actual_y = actual["next_y"].get<vector<double>>();
+            if (expected_x.size() != expected_y.size() || actual_x.size() != actual_y.size()) {
+                throw runtime_error("next_x and next_y differ in length");
+            }
+        } catch (const exception &e) {
+            if (mismatches++ < GOLDEN_REPORTED_MISMATCHES) {
+                cout << "  message " << messages << ": " << e.what() << "\n";
+            }
+            continue;
+        }
+
+        // Where the paths first part ways by more than the tolerance, if they do
+        int differs_at = -1;
+        double error = 0;
+        for (size_t i = 0; i < min(expected_x.size(), actual_x.size()); i++) {
+            double point_error = max(fabs(expected_x[i] - actual_x[i]), fabs(expected_y[i] - actual_y[i]));
+            error = max(error, point_error);
+            if (point_error > options.tolerance && differs_at < 0) {
+                differs_at = (int) i;
+            }
+        }
+        max_error = max(max_error, error);
+
+        if (differs_at >= 0 || expected_x.size() != actual_x.size()) {
+            if (mismatches++ < GOLDEN_REPORTED_MISMATCHES) {
+                cout << "  message " << messages << ": " << actual_x.size() << " points for "
+                     << expected_x.size() << " expected";
+                if (differs_at >= 0) {
+                    cout << ", point " << differs_at << " off by up to " << error << " m";
+                }
+                cout << "\n";
+            }
+        }
+    }
+    gzclose(in);
+
+    if (!readable) {
+        cerr << file << ": malformed frame after message " << messages << endl;
+        return false;
+    }
+    cout << file << ": " << messages << " messages, " << mismatches << " different, max difference "
+         << max_error << " m" << endl;
+    return messages > 0 && mismatches == 0;
+}
+
+static bool parse_options(int argc, char *argv[], Options &options) {
+    for (int i = 2; i < argc; i++) {
+        string name = argv[i];
+        if (name.compare(0, 2, "--") != 0) {
+            options.corpus_files.push_back(name);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << name << endl;
+            return false;
+        }
+        string value = argv[++i];
+
+        try {
+            if (name == "--map") {
+                options.map_file = value;
+            } else if (name == "--config") {
+                if (!load_config(value, options.config) || !validate_config(options.config)) {
+                    return false;
+                }
+            } else if (name == "--seed") {
+                options.seed = stoul(value);
+            } else if (name == "--traffic") {
+                options.traffic = max(0, stoi(value));
+            } else if (name == "--steps") {
+                options.steps = max(1, stoi(value));
+            } else if (name == "--seconds") {
+                options.seconds = max(1., stod(value));
+            } else if (name == "--tolerance") {
+                options.tolerance = max(0., stod(value));
+            } else if (name == "--planner") {
+                options.planner_command = value;
+            } else {
+                cerr << "Unknown option " << name << endl;
+                return false;
+            }
+        } catch (const exception &e) {
+            cerr << "Bad value " << value << " for " << name << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    string mode = argc > 1 ? argv[1] : "";
+    Options options;
+    if ((mode != "record" && mode != "check") || !parse_options(argc, argv, options)
+        || (mode == "record" && options.corpus_files.size() != 1)) {
+        cerr << "Usage: " << argv[0] << " record <corpus.jsonl.gz> [--map <csv>] [--config <json>] [--seed <n>]"
+             << " [--traffic <cars>] [--steps <n>] [--seconds <s>] [--planner <command>]\n"
+             << "       " << argv[0] << " check [<corpus.jsonl.gz>...] [--map <csv>] [--tolerance <m>]"
+             << " [--planner <command>]" << endl;
+        return 1;
+    }
+    if (options.corpus_files.empty()) {
+        options.corpus_files.assign(begin(GOLDEN_CORPUS), end(GOLDEN_CORPUS));
+    }
+
+    if (mode == "record") {
+        return record(options.corpus_files[0], options) ? 0 : 1;
+    }
+
+    bool passed = true;
+    for (const string &file : options.corpus_files) {
+        passed = check(file, options) && passed;
+    }
+    if (!passed) {
+        cout << "FAILED: planner output differs from the golden trajectories" << endl;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+//
+// Headless stand-in for the Unity simulator, for load testing the planner locally.
+// Connects N ego cars to the planner on port 4567 speaking the same socket.io frames as the simulator,
+// drives them through background traffic on the highway map and reports throughput, latency and how
+// well the cars drove. Runs in lockstep: every car gets its telemetry, and once all of them have
+// answered the world moves on by --steps time steps, so it runs as fast as the planner can keep up.
+//
+// Run the planner with `--fleet <workers>` when driving more than one car. With `--binary <flags>` the cars
+// speak the binary protocol from Protocol.h instead, negotiating the given BINARY_* flags on connect.
+//
+
+#include <math.h>
+#include <uWS/uWS.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Json.h"
+#include "Map.h"
+#include "Protocol.h"
+#include "Simulation.h"
+#include "Telemetry.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+struct SimulatorClient {
+    int ego;
+    uWS::WebSocket<uWS::CLIENT> ws;
+    bool connected = false;
+    bool ready = false;   // connected, and done negotiating the binary protocol if it's used
+    bool waiting = false; // telemetry sent, no control back yet
+    chrono::steady_clock::time_point sent_at;
+    // The previous path in the last telemetry, for BINARY_TAIL replies to build on
+    vector<double> path_x;
+    vector<double> path_y;
+};
+
+struct Options {
+    int cars = 1;
+    int traffic = 12;
+    int steps = 3; // points the simulator drives between messages, like the real one's latency
+    int rounds = 15000; // about five minutes of driving with 3 steps per round
+    unsigned int seed = 42;
+    int binary = -1; // flags to negotiate, or -1 to send socket.io text like the simulator
+    string url = "ws://127.0.0.1:4567";
+    string map_file = "../data/highway_map.csv";
+};
+
+static Options parse_options(int argc, char *argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string name = argv[i];
+        string value = argv[i + 1];
+        if (name == "--cars") {
+            options.cars = max(1, stoi(value));
+        } else if (name == "--traffic") {
+            options.traffic = max(0, stoi(value));
+        } else if (name == "--steps") {
+            options.steps = max(1, stoi(value));
+        } else if (name == "--rounds") {
+            options.rounds = max(1, stoi(value));
+        } else if (name == "--seed") {
+            options.seed = stoul(value);
+        } else if (name == "--binary") {
+            options.binary = stoi(value) & BINARY_SUPPORTED_FLAGS;
+        } else if (name == "--url") {
+            options.url = value;
+        } else if (name == "--map") {
+            options.map_file = value;
+        } else {
+            cerr << "Unknown option " << name << endl;
+        }
+    }
+    return options;
+}
+
+static double percentile(vector<double> &values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t i = min(values.size() - 1, (size_t) (p * values.size()));
+    nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+
+static void report(const Simulation &sim,
+                   vector<double> &latencies_ms,
+                   int rounds,
+                   double wall_seconds,
+                   size_t bytes_sent,
+                   size_t bytes_received) {
+    size_t replies = max(latencies_ms.size(), (size_t) 1);
+    cout << "\nRounds: " << rounds << ", simulated " << sim.elapsed() << " s in " << wall_seconds << " s ("
+         << sim.elapsed() / max(wall_seconds, 1e-9) << "x real time)\n";
+    cout << "Replies: " << latencies_ms.size() << " (" << latencies_ms.size() / max(wall_seconds, 1e-9) << " per s)\n";
+    cout << "Bytes per message: telemetry " << bytes_sent / replies << ", control " << bytes_received / replies << "\n";
+    cout << "Latency ms: p50 " << percentile(latencies_ms, .5) << ", p95 " << percentile(latencies_ms, .95)
+         << ", p99 " << percentile(latencies_ms, .99) << ", max " << percentile(latencies_ms, 1.) << "\n";
+
+    for (int i = 0; i < sim.num_egos(); i++) {
+        const EgoCar &ego = sim.ego(i);
+        cout << "Car " << i << ": " << ego.distance / 1609.34 << " miles, "
+             << ego.collisions << " collisions, "
+             << ego.speeding_steps << " speeding steps, "
+             << ego.out_of_lane_steps << " out of lane steps, "
+             << ego.starved_steps << " starved steps, "
+             << "max accel " << ego.max_accel << " m/s^2, max jerk " << ego.max_jerk << " m/s^3\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options = parse_options(argc, argv);
+
+    Map map;
+    if (!map.load_map(options.map_file)) {
+        return 1;
+    }
+
+    Simulation sim(map, options.cars, options.traffic, options.seed);
+
+    vector<SimulatorClient> clients(options.cars);
+    for (int i = 0; i < options.cars; i++) {
+        clients[i].ego = i;
+    }
+
+    int ready = 0;
+    int pending = 0;
+    int rounds = 0;
+    bool finished = false;
+    Telemetry telemetry;
+    string frame;
+    size_t bytes_sent = 0;
+    size_t bytes_received = 0;
+    uint32_t sequence = 0;
+    vector<double> latencies_ms;
+    latencies_ms.reserve((size_t) options.rounds * options.cars);
+    auto started = chrono::steady_clock::now();
+
+    uWS::Hub h;
+
+    auto send_telemetry = [&]() {
+        for (SimulatorClient &client : clients) {
+            if (!client.ready) {
+                continue;
+            }
+            sim.telemetry(client.ego, telemetry);
+            if (options.binary >= 0) {
+                write_binary_telemetry(frame, telemetry, options.binary, ++sequence);
+                client.path_x = telemetry.previous_path_x;
+                client.path_y = telemetry.previous_path_y;
+            } else {
+                frame = "42[\"telemetry\"," + encode_telemetry(telemetry).dump() + "]";
+            }
+            bytes_sent += frame.length();
+            client.sent_at = chrono::steady_clock::now();
+            client.waiting = true;
+            pending++;
+            client.ws.send(frame.data(), frame.length(),
+                           options.binary >= 0 ? uWS::OpCode::BINARY : uWS::OpCode::TEXT);
+        }
+    };
+
+    auto finish = [&]() {
+        finished = true;
+        double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        report(sim, latencies_ms, rounds, wall_seconds, bytes_sent, bytes_received);
+        for (SimulatorClient &client : clients) {
+            if (client.connected) {
+                client.ws.close();
+            }
+        }
+    };
+
+    // Once every car has answered, move the world on and start the next round
+    auto reply_received = [&]() {
+        if (--pending > 0 || finished) {
+            return;
+        }
+        for (int k = 0; k < options.steps; k++) {
+            sim.step();
+        }
+        if (++rounds >= options.rounds || ready == 0) {
+            finish();
+        } else {
+            send_telemetry();
+        }
+    };
+
+    // Driving starts once every car is connected and, for binary, has its HELLO answered
+    auto client_ready = [&](SimulatorClient *client) {
+        client->ready = true;
+        if (++ready == options.cars) {
+            cout << "All " << ready << " cars connected, driving..." << endl;
+            started = chrono::steady_clock::now();
+            send_telemetry();
+        }
+    };
+
+    h.onConnection([&](uWS::WebSocket<uWS::CLIENT> ws, uWS::HttpRequest req) {
+        SimulatorClient *client = static_cast<SimulatorClient *>(ws.getUserData());
+        client->ws = ws;
+        client->connected = true;
+        if (options.binary >= 0) {
+            write_binary_hello(frame, BINARY_HELLO, options.binary);
+            ws.send(frame.data(), frame.length(), uWS::OpCode::BINARY);
+        } else {
+            client_ready(client);
+        }
+    });
+
+    h.onMessage([&](uWS::WebSocket<uWS::CLIENT> ws, char *data, size_t length, uWS::OpCode opCode) {
+        SimulatorClient *client = static_cast<SimulatorClient *>(ws.getUserData());
+
+        BinaryHeader header;
+        if (opCode == uWS::OpCode::BINARY && read_binary_header(data, length, header)) {
+            uint8_t flags;
+            if (header.type == BINARY_HELLO_ACK && !client->ready && read_binary_hello(data, length, flags)) {
+                if (flags != options.binary) {
+                    cerr << "Planner accepted binary flags " << (int) flags << " rather than " << options.binary << endl;
+                    options.binary = flags;
+                }
+                client_ready(client);
+                return;
+            }
+            if (header.type != BINARY_CONTROL || !client->waiting) {
+                return;
+            }
+            if (read_binary_control(data, length, options.binary, client->path_x, client->path_y)) {
+                sim.control(client->ego, client->path_x, client->path_y);
+            }
+        } else {
+            if (!client->waiting || length <= 2 || data[0] != '4' || data[1] != '2') {
+                return;
+            }
+
+            auto j = json::parse(string(data + 2, length - 2));
+            if (j[0].get<string>() == "control") {
+                sim.control(client->ego, j[1]["next_x"], j[1]["next_y"]);
+            }
+        }
+        bytes_received += length;
+
+        client->waiting = false;
+        latencies_ms.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - client->sent_at).count());
+        reply_received();
+    });
+
+    h.onDisconnection([&](uWS::WebSocket<uWS::CLIENT> ws, int code, char *message, size_t length) {
+        SimulatorClient *client = static_cast<SimulatorClient *>(ws.getUserData());
+        client->connected = false;
+        if (client->ready) {
+            client->ready = false;
+            ready--;
+        }
+        if (client->waiting) {
+            client->waiting = false;
+            reply_received();
+        }
+    });
+
+    h.onError([](void *user) {
+        cerr << "Could not connect a car to the planner, is it running?" << endl;
+    });
+
+    for (SimulatorClient &client : clients) {
+        h.connect(options.url, &client);
+    }
+
+    h.run();
+}
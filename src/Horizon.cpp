@@ -0,0 +1,77 @@
+//
+// Adaptive path length, see Horizon.h
+//
+
+#include <algorithm>
+#include <math.h>
+#include "Horizon.h"
+#include "PathPlanner.h"
+
+using namespace std;
+
+void HorizonStats::merge(const HorizonStats &other) {
+    if (other.messages == 0) {
+        return;
+    }
+    min_horizon = messages == 0 ? other.min_horizon : min(min_horizon, other.min_horizon);
+    max_horizon = max(max_horizon, other.max_horizon);
+    messages += other.messages;
+    points_sent += other.points_sent;
+    max_driven = max(max_driven, other.max_driven);
+    starved += other.starved;
+    plan_seconds += other.plan_seconds;
+    max_plan_seconds = max(max_plan_seconds, other.max_plan_seconds);
+    over_budget += other.over_budget;
+}
+
+int HorizonController::observe(int prev_size) {
+    if (sent == 0) {
+        return 0;
+    }
+    // A client that hands back more than we sent isn't one we can learn anything from. One that hands back
+    // nothing may have waited even longer, but the margin in horizon makes up for that next time.
+    int driven = max(0, sent - prev_size);
+    if (prev_size == 0) {
+        stats.starved++;
+    }
+    stats.max_driven = max(stats.max_driven, driven);
+    peak_driven = max((double) driven, peak_driven * HORIZON_DECAY);
+    return driven;
+}
+
+int HorizonController::horizon(const PlannerConfig &config) const {
+    if (peak_driven < 0) {
+        return config.num_points;
+    }
+    // Cover the longest recent gap between messages with room to spare, plus the time we take ourselves
+    double lead_seconds = max(config.latency_budget_ms / 1000, peak_plan_seconds);
+    int points = (int) ceil(HORIZON_MARGIN * peak_driven + lead_seconds / SIMULATOR_TIME_STEP);
+    return min(max(points, config.min_points), config.num_points);
+}
+
+void HorizonController::sent_path(int points, double plan_seconds, const PlannerConfig &config) {
+    sent = points;
+    if (timed) {
+        peak_plan_seconds = max(plan_seconds, peak_plan_seconds * HORIZON_DECAY);
+    }
+
+    stats.min_horizon = stats.messages == 0 ? points : min(stats.min_horizon, points);
+    stats.max_horizon = max(stats.max_horizon, points);
+    stats.messages++;
+    stats.points_sent += points;
+    stats.plan_seconds += plan_seconds;
+    stats.max_plan_seconds = max(stats.max_plan_seconds, plan_seconds);
+    if (plan_seconds * 1000 > config.latency_budget_ms) {
+        stats.over_budget++;
+    }
+}
+
+void print_horizon_stats(ostream &out, const HorizonStats &stats) {
+    if (stats.messages == 0) {
+        return;
+    }
+    out << "Horizon: " << (double) stats.points_sent / stats.messages << " points per path (" << stats.min_horizon
+        << "-" << stats.max_horizon << "), up to " << stats.max_driven << " driven between messages, "
+        << stats.starved << " starved, planning " << stats.plan_seconds / stats.messages * 1e6 << " us (max "
+        << stats.max_plan_seconds * 1e6 << " us, " << stats.over_budget << " over budget)\n";
+}
@@ -0,0 +1,60 @@
+//
+// How many points to send back each message. The simulator keeps driving the path it has while we plan, so
+// the path has to outlast the gap between messages plus our own planning time, but every point beyond that
+// is one we're committed to and can't react with. HorizonController watches how many points the client
+// actually drives between messages and how long planning takes, and sends just enough to stay ahead by a
+// margin, between PlannerConfig::min_points and num_points.
+//
+
+#ifndef PATH_PLANNING_HORIZON_H
+#define PATH_PLANNING_HORIZON_H
+
+#include <cstdint>
+#include <ostream>
+
+using namespace std;
+
+struct PlannerConfig;
+
+// How much of the recent peaks is kept each message, about 70 messages to halve
+static const double HORIZON_DECAY = .99;
+// Send enough for a gap this many times the worst one recently seen
+static const double HORIZON_MARGIN = 2.;
+
+struct HorizonStats {
+    uint64_t messages = 0;
+    uint64_t points_sent = 0;
+    int min_horizon = 0;
+    int max_horizon = 0;
+    int max_driven = 0;         // most points driven between two messages
+    uint64_t starved = 0;       // messages where the client had driven everything we sent
+    double plan_seconds = 0;
+    double max_plan_seconds = 0;
+    uint64_t over_budget = 0;   // messages planned slower than latency_budget_ms
+
+    void merge(const HorizonStats &other);
+};
+
+class HorizonController {
+    int sent = 0; // path length we sent last time
+    double peak_driven = -1; // until the client has driven some of a path, send the longest one
+    double peak_plan_seconds = 0;
+
+public:
+    HorizonStats stats;
+    // false to leave planning time out of the horizon, so replaying the same messages gives the same paths
+    bool timed = true;
+
+    // Points driven since the last message, now that prev_size of the ones we sent are left
+    int observe(int prev_size);
+
+    // Path length to send this message
+    int horizon(const PlannerConfig &config) const;
+
+    // A path of this many points went out, after plan_seconds of planning
+    void sent_path(int points, double plan_seconds, const PlannerConfig &config);
+};
+
+void print_horizon_stats(ostream &out, const HorizonStats &stats);
+
+#endif //PATH_PLANNING_HORIZON_H
@@ -0,0 +1,19 @@
+//
+// nlohmann::json from third_party. GCC 12 reports -Wmaybe-uninitialized from inside its value swap wherever an
+// assignment like j["key"] = value gets inlined into our code, a false positive that being a system header
+// doesn't keep out, so it is turned off for the header's code only.
+//
+
+#ifndef PATH_PLANNING_JSON_H
+#define PATH_PLANNING_JSON_H
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <json.hpp>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif //PATH_PLANNING_JSON_H
@@ -0,0 +1,52 @@
+//
+// Lane model with the lane count fixed at compile time, so lane classification is a multiply, a floor and
+// a clamp with no branches, and the planner gets a specialized copy for every supported road width.
+// Lane width comes from the map at run time, the count has to be one of MIN_LANES..MAX_LANES.
+//
+
+#ifndef PATH_PLANNING_LANE_GEOMETRY_H
+#define PATH_PLANNING_LANE_GEOMETRY_H
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+static const int MIN_LANES = 2;
+static const int MAX_LANES = 6;
+
+template<int NumLanes>
+struct LaneGeometry {
+    static_assert(NumLanes >= MIN_LANES && NumLanes <= MAX_LANES, "Unsupported number of lanes");
+
+    static constexpr int num_lanes = NumLanes;
+    static constexpr int last_lane = NumLanes - 1;
+
+    double width;
+    double inv_width;
+
+    explicit LaneGeometry(double width) : width(width), inv_width(1. / width) {}
+
+    // Lane d falls in, -1 left of the road and NumLanes right of it
+    int lane_index(double d) const {
+        double lane = floor(d * inv_width);
+        return (int) min(max(lane, -1.), (double) NumLanes);
+    }
+
+    double left_edge(int lane) const { return width * lane; }
+    double center(int lane) const { return width * (lane + .5); }
+};
+
+// Call f(LaneGeometry<num_lanes>(width)) for a run time lane count, which has to be in MIN_LANES..MAX_LANES
+template<typename F>
+void with_lane_geometry(int num_lanes, double width, F f) {
+    switch (num_lanes) {
+        case 2: f(LaneGeometry<2>(width)); break;
+        case 3: f(LaneGeometry<3>(width)); break;
+        case 4: f(LaneGeometry<4>(width)); break;
+        case 5: f(LaneGeometry<5>(width)); break;
+        default: f(LaneGeometry<6>(width)); break;
+    }
+}
+
+#endif //PATH_PLANNING_LANE_GEOMETRY_H
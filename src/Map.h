@@ -5,6 +5,7 @@
 #ifndef PATH_PLANNING_MAP_HELPER_H
 #define PATH_PLANNING_MAP_HELPER_H
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <math.h>
@@ -12,12 +13,36 @@
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
 #include "Eigen-3.3/Eigen/QR"
+#include "Frenet.h"
 
 using namespace std;
 
 // The max s value before wrapping around the track back to 0
 const double MAX_S = 6945.554;
 
+// The simulator's road, what load_map uses unless told otherwise
+static const int NUM_LANES = 3; // FYI: Lanes are indexed at 0.
+static const double LANE_WIDTH = 4.; // in meters, useful for d part of Frenet coordinates
+static const double HALF_LANE_WIDTH = LANE_WIDTH / 2.; // to avoid having to compute /2 everytime.
+
+// Spacing in s between the precomputed lane-center points, in meters
+static const double LANE_POLYLINE_STEP = .5;
+
+// A warm-started getFrenet searches the whole map instead when it ends up further than this from the road,
+// in meters, or would have to move on more than this many segments
+static const double FRENET_LOCAL_SEARCH_DISTANCE = 30.;
+static const int FRENET_LOCAL_SEARCH_SEGMENTS = 8;
+// Size of the cells in the grid that finds the map segments near a position, in meters
+static const double SEGMENT_GRID_CELL = 50.;
+
+// A vehicle's position and velocity along and across the road
+struct FrenetState {
+    double s;
+    double d;
+    double s_dot; // m/s along the road
+    double d_dot; // m/s sideways, positive is drifting to the right
+};
+
 class Map {
 
 private:
@@ -26,24 +51,105 @@ private:
     vector<double> map_waypoints_s;
     vector<double> map_waypoints_dx;
     vector<double> map_waypoints_dy;
+    // 1 / squared length of the segment starting at each waypoint
+    vector<double> segment_inv_length2;
+
+    // Length of the closed loop, i.e. where s wraps back to 0
+    double track_length = MAX_S;
+
+    int num_lanes = NUM_LANES;
+    double lane_width = LANE_WIDTH;
+
+    // Different for every load, so state derived from one map can tell it's been swapped for another
+    uint64_t generation = 0;
+
+    // Dense lane-center points for each lane, point i sits at s = i * LANE_POLYLINE_STEP
+    vector<vector<double>> lane_points_x;
+    vector<vector<double>> lane_points_y;
+
+    // Uniform grid over the waypoints' bounding box, listing the segments passing through each cell,
+    // so ClosestSegment only looks at the ones near a position. Cell i's are grid_segments[grid_cell_start[i]..]
+    double grid_min_x = 0;
+    double grid_min_y = 0;
+    int grid_cols = 0;
+    int grid_rows = 0;
+    vector<int> grid_cell_start;
+    vector<int> grid_segments;
+
+    void build_lane_polylines();
+    void build_segment_grid();
+
+    // getXY for when the waypoint segment s falls in is already known
+    pair<double, double> segmentXY(int prev_wp, double s, double d) const;
+
+    SegmentProjection projectOntoSegment(int prev_wp, double x, double y) const;
+
+    // Segment closest to (x, y), from the grid if (x, y) is within it
+    int ClosestSegment(double x, double y) const;
+
+    // Same, checking every segment
+    int ClosestSegmentSweep(double x, double y) const;
+
+    // Segment closest to (x, y) walking from segment start to whichever neighbor is closer until neither is,
+    // -1 if it's still getting closer after max_steps
+    int LocalClosestSegment(int start, double x, double y, int max_steps) const;
+
+    pair<double, double> segmentFrenet(int prev_wp, double x, double y) const;
 
 public:
-    // Load up map values for waypoint's x,y,s and d normalized normal vectors
-    void load_map(string map_file);
+    // Load up map values for waypoint's x,y,s and d normalized normal vectors, for a road with num_lanes lanes.
+    // Lines that don't parse are skipped. False (and a message on cerr) if that leaves fewer than two waypoints
+    // or s doesn't go up from one to the next, the map is empty then and mustn't be queried.
+    bool load_map(string map_file, int num_lanes = NUM_LANES, double lane_width = LANE_WIDTH);
 
     // For converting back and forth between radians and degrees.
-    double deg2rad(double x) { return x * M_PI / 180; }
-    double rad2deg(double x) { return x * 180 / M_PI; }
+    double deg2rad(double x) const { return x * M_PI / 180; }
+    double rad2deg(double x) const { return x * 180 / M_PI; }
+
+    double distance(double x1, double y1, double x2, double y2) const;
+
+    int ClosestWaypoint(double x, double y) const;
+
+    int NextWaypoint(double x, double y, double theta) const;
+
+    // Index of the waypoint starting the map segment that s falls in
+    int WaypointSegment(double s) const;
+
+    // Transform from Cartesian x,y to Frenet s,d by projecting onto the closest map segment, the one getXY uses
+    // for that s, so the two round-trip. theta isn't needed for that and is only kept for callers.
+    pair<double, double> getFrenet(double x, double y, double theta) const;
+
+    // Same, starting the search from s_hint, e.g. where the same car was last time, which only looks at
+    // a few segments around it unless (x, y) turns out to be far from there
+    pair<double, double> getFrenet(double x, double y, double theta, double s_hint) const;
+
+    // Same, starting from the map segment index in segment and updating it to the one (x, y) projects onto,
+    // see FrenetTracker. Searches the whole map if segment is -1 or not one of this map's.
+    pair<double, double> getFrenetNear(int &segment, double x, double y) const;
 
-    double distance(double x1, double y1, double x2, double y2);
+    // Frenet positions and velocities for a whole batch of vehicles given as x, y, v_x, v_y arrays of the same
+    // length. segments works like getFrenetNear's, one per vehicle, grown with -1s if it's shorter, so passing
+    // the same one back every tick keeps each vehicle's warm start.
+    void getFrenetStates(const vector<double> &x,
+                         const vector<double> &y,
+                         const vector<double> &v_x,
+                         const vector<double> &v_y,
+                         vector<int> &segments,
+                         vector<FrenetState> &states) const;
 
-    int ClosestWaypoint(double x, double y);
+    pair<double, double> getXY(double s, double d) const;
 
-    int NextWaypoint(double x, double y, double theta);
+    // Same as getXY(s, lane_center(lane)), but read off the precomputed lane polylines
+    pair<double, double> getLaneXY(double s, int lane) const;
 
-    pair<double, double> getFrenet(double x, double y, double theta);
+    double get_track_length() const { return track_length; }
+    int num_waypoints() const { return map_waypoints_s.size(); }
+    uint64_t get_generation() const { return generation; }
 
-    pair<double, double> getXY(double s, double d);
+    int get_num_lanes() const { return num_lanes; }
+    double get_lane_width() const { return lane_width; }
+    // d of the middle of the lane
+    double lane_center(int lane) const { return lane_width * (lane + .5); }
 };
 
 #endif //PATH_PLANNING_MAP_HELPER_H
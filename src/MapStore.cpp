@@ -0,0 +1,82 @@
+//
+// Map snapshots and reloading, see MapStore.h
+//
+
+#include <sys/stat.h>
+#include <iostream>
+#include "MapStore.h"
+
+using namespace std;
+
+MapStore::MapStore(const string &map_file, int num_lanes, double lane_width)
+        : map_file(map_file), num_lanes(num_lanes), lane_width(lane_width), loading(false) {}
+
+MapStore::~MapStore() {
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+MapStore::FileVersion MapStore::file_version() const {
+    FileVersion version;
+    struct stat info;
+    if (stat(map_file.c_str(), &info) == 0) {
+        version.mtime = (long long) info.st_mtime;
+        version.size = (long long) info.st_size;
+    }
+    return version;
+}
+
+shared_ptr<const Map> MapStore::build() const {
+    shared_ptr<Map> map = make_shared<Map>();
+    if (!map->load_map(map_file, num_lanes, lane_width)) {
+        return nullptr;
+    }
+    return map;
+}
+
+bool MapStore::load() {
+    loaded_version = file_version();
+    changed_version = loaded_version;
+
+    // load_map has said what's wrong with it
+    shared_ptr<const Map> map = build();
+    if (!map) {
+        return false;
+    }
+    atomic_store(&current, map);
+    return true;
+}
+
+void MapStore::check_for_changes() {
+    if (loading) {
+        return;
+    }
+    if (loader.joinable()) {
+        loader.join();
+    }
+
+    FileVersion version = file_version();
+    if (version == loaded_version || version.mtime < 0) {
+        changed_version = loaded_version;
+        return;
+    }
+    if (version != changed_version) {
+        // Changed since the last check, give whoever is writing it time to finish
+        changed_version = version;
+        return;
+    }
+
+    loaded_version = version;
+    loading = true;
+    loader = thread([this]() {
+        shared_ptr<const Map> map = build();
+        if (map) {
+            atomic_store(&current, map);
+            cout << "Reloaded map " << map_file << endl;
+        } else {
+            cerr << "Kept the old map" << endl;
+        }
+        loading = false;
+    });
+}
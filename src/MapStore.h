@@ -0,0 +1,63 @@
+//
+// The current waypoint map as an immutable snapshot that can be swapped for a newer one while cars keep
+// driving. Readers take a reference to whatever snapshot is current and plan a whole message with it; when
+// the map file changes on disk, the new Map (lane polylines and all) is built on a background thread and
+// published with one atomic pointer swap. The old snapshot goes away once the last reader lets go of it.
+//
+
+#ifndef PATH_PLANNING_MAP_STORE_H
+#define PATH_PLANNING_MAP_STORE_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include "Map.h"
+
+using namespace std;
+
+class MapStore {
+
+private:
+    string map_file;
+    int num_lanes;
+    double lane_width;
+
+    // Only ever accessed with atomic_load/atomic_store
+    shared_ptr<const Map> current;
+
+    // What the file looked like when current was loaded, and when the last check saw it change
+    struct FileVersion {
+        long long mtime = -1;
+        long long size = -1;
+        bool operator==(const FileVersion &other) const { return mtime == other.mtime && size == other.size; }
+        bool operator!=(const FileVersion &other) const { return !(*this == other); }
+    };
+    FileVersion loaded_version;
+    FileVersion changed_version;
+
+    thread loader;
+    atomic<bool> loading;
+
+    FileVersion file_version() const;
+
+    // nullptr if the file doesn't hold a usable map
+    shared_ptr<const Map> build() const;
+
+public:
+    MapStore(const string &map_file, int num_lanes, double lane_width);
+    ~MapStore();
+
+    // Load the map right away, false if the file doesn't hold a usable map
+    bool load();
+
+    // The snapshot to plan with, safe from any thread
+    shared_ptr<const Map> get() const { return atomic_load(&current); }
+
+    // Kick off a background reload if the file changed on disk. Only reloads once the file has looked the same
+    // on two checks in a row, so a file still being written isn't picked up half way. Not thread safe, call it
+    // from one thread, e.g. a timer on the websocket loop.
+    void check_for_changes();
+};
+
+#endif //PATH_PLANNING_MAP_STORE_H
@@ -0,0 +1,121 @@
+//
+// Converts a CSV waypoint map into the tile file TiledMap reads, and with --check compares what TiledMap
+// answers against Map over the whole loop, reporting the tile cache's hit rate along the way.
+//
+//   map_tiler <map.csv> <map.tiles> [--tile-size <waypoints>] [--cache <tiles>] [--check]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include "Map.h"
+#include "TiledMap.h"
+
+using namespace std;
+
+static double distance_between(pair<double, double> a, pair<double, double> b) {
+    return sqrt((a.first - b.first) * (a.first - b.first) + (a.second - b.second) * (a.second - b.second));
+}
+
+// Drive around the loop the way a car would, querying both maps, returns false if they disagree
+static bool check(const string &map_file, const string &tile_file, int cache_size) {
+    Map map;
+    if (!map.load_map(map_file)) {
+        return false;
+    }
+
+    TiledMap tiled(NUM_LANES, LANE_WIDTH, cache_size);
+    if (!tiled.open(tile_file)) {
+        return false;
+    }
+
+    double max_xy_error = 0;
+    double max_lane_error = 0;
+    double max_s_error = 0;
+    double max_d_error = 0;
+    double max_near_s_error = 0; // warm-started from the last tile, the way a car would convert its positions
+    double max_near_d_error = 0;
+    int segment_mismatches = 0;
+    int tile = -1;
+    mt19937 rng(1);
+    uniform_real_distribution<double> random_d(-1, NUM_LANES * LANE_WIDTH + 1);
+
+    double track_length = map.get_track_length();
+    for (double s = 0; s < track_length; s += .37) {
+        tiled.prefetch(s, 100);
+
+        double d = random_d(rng);
+        max_xy_error = max(max_xy_error, distance_between(map.getXY(s, d), tiled.getXY(s, d)));
+        for (int lane = 0; lane < NUM_LANES; lane++) {
+            max_lane_error = max(max_lane_error, distance_between(map.getLaneXY(s, lane), tiled.getLaneXY(s, lane)));
+        }
+        if (map.WaypointSegment(s) != tiled.WaypointSegment(s)) {
+            segment_mismatches++;
+        }
+
+        pair<double, double> xy = map.getXY(s, d);
+        pair<double, double> ahead = map.getXY(s + 1, d);
+        double theta = atan2(ahead.second - xy.second, ahead.first - xy.first);
+        pair<double, double> expected = map.getFrenet(xy.first, xy.second, theta);
+        pair<double, double> frenet = tiled.getFrenet(xy.first, xy.second, theta);
+        max_s_error = max(max_s_error, fabs(expected.first - frenet.first));
+        max_d_error = max(max_d_error, fabs(expected.second - frenet.second));
+
+        pair<double, double> near = tiled.getFrenetNear(tile, xy.first, xy.second);
+        pair<double, double> hinted = tiled.getFrenet(xy.first, xy.second, theta, s - 5);
+        max_near_s_error = max(max_near_s_error, max(fabs(expected.first - near.first),
+                                                     fabs(expected.first - hinted.first)));
+        max_near_d_error = max(max_near_d_error, max(fabs(expected.second - near.second),
+                                                     fabs(expected.second - hinted.second)));
+    }
+
+    TileCacheStats stats = tiled.cache_stats();
+    cout << tiled.num_waypoints() << " waypoints in " << tiled.num_tiles() << " tiles, cache of " << cache_size
+         << ": " << stats.loads << " loads, " << stats.hits << " hits, " << stats.evictions << " evictions\n";
+    cout << "Max difference to Map: getXY " << max_xy_error << " m, getLaneXY " << max_lane_error
+         << " m, getFrenet s " << max_s_error << " d " << max_d_error << " (warm-started s " << max_near_s_error
+         << " d " << max_near_d_error << "), WaypointSegment mismatches " << segment_mismatches << endl;
+
+    return max_xy_error < 1e-9 && max_lane_error < 1e-9 && max_s_error < 1e-9 && max_d_error < 1e-9
+           && max_near_s_error < 1e-9 && max_near_d_error < 1e-9 && segment_mismatches == 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <map.csv> <map.tiles> [--tile-size <waypoints>] [--cache <tiles>] [--check]"
+             << endl;
+        return 1;
+    }
+
+    string map_file = argv[1];
+    string tile_file = argv[2];
+    int tile_size = DEFAULT_WAYPOINTS_PER_TILE;
+    int cache_size = DEFAULT_TILE_CACHE_SIZE;
+    bool run_check = false;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc) {
+            tile_size = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_size = max(2, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--check") == 0) {
+            run_check = true;
+        } else {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    if (!write_tile_file(map_file, tile_file, tile_size)) {
+        return 1;
+    }
+    cout << "Wrote " << tile_file << endl;
+
+    if (run_check && !check(map_file, tile_file, cache_size)) {
+        cerr << "Tiled map doesn't match" << endl;
+        return 1;
+    }
+    return 0;
+}
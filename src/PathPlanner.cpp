@@ -0,0 +1,379 @@
+//
+// Behavior and trajectory generation, see PathPlanner.h
+//
+
+#include <chrono>
+#include <math.h>
+#include "Frenet.h"
+#include "LaneGeometry.h"
+#include "PathPlanner.h"
+
+using namespace std;
+
+typedef CubicSpline<SPLINE_ANCHORS> ReferenceSpline;
+
+// Signed curvature (1/m) of the spline at local x, positive bending left
+static double spline_curvature(const ReferenceSpline &spline, double x) {
+    double dy = spline.derivative(x);
+    return spline.second_derivative(x) / pow(1 + dy * dy, 1.5);
+}
+
+// Sharpest bend of the spline between local x 0 and x_end, and the fastest its curvature changes there (1/m^2,
+// per meter of local x, which is never more than along the curve), one look every ARC_LENGTH_STEP
+static void peak_spline_bends(const ReferenceSpline &spline, double x_end, double &peak_curvature,
+                              double &peak_curvature_rate) {
+    double previous = spline_curvature(spline, 0);
+    peak_curvature = fabs(previous);
+    peak_curvature_rate = 0;
+    for (double x = ARC_LENGTH_STEP; x <= x_end; x += ARC_LENGTH_STEP) {
+        double curvature = spline_curvature(spline, x);
+        peak_curvature = max(peak_curvature, fabs(curvature));
+        peak_curvature_rate = max(peak_curvature_rate, fabs(curvature - previous) / ARC_LENGTH_STEP);
+        previous = curvature;
+    }
+}
+
+const pair<vector<double>, vector<double>> &plan_path(const Map &map, const Telemetry &telemetry, PlannerState &state) {
+    auto started = chrono::steady_clock::now();
+
+    // s means something else on a reloaded map, so start over on tracks and the spline
+    if (state.map_generation != map.get_generation()) {
+        state.map_generation = map.get_generation();
+        state.tracker.clear();
+        state.trajectory.valid = false;
+    }
+
+    // Whatever is missing from the path we sent last was driven since the last message
+    int driven = state.horizon.observe(telemetry.previous_path_x.size());
+    state.tracker.begin_tick(driven * SIMULATOR_TIME_STEP);
+    int num_points = state.horizon.horizon(state.config);
+
+    {
+        AllocationScope scope(state.allocations[STAGE_DECIDE]);
+        determine_lane_and_velocity(state.config, map, telemetry, state.lane, state.target_velocity, state.tracker,
+                                    state.grid);
+    }
+
+    {
+        AllocationScope scope(state.allocations[STAGE_TRAJECTORY]);
+        generate_trajectory_for_lane(state.config, telemetry, map, state.lane, state.target_velocity, num_points,
+                                     state.trajectory, state.path.first, state.path.second);
+    }
+
+    double plan_seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    state.horizon.sent_path(state.path.first.size(), plan_seconds, state.config);
+    return state.path;
+}
+
+// The lane and speed decision for a road with a known number of lanes
+template<int NumLanes>
+static void decide_lane_and_velocity(const LaneGeometry<NumLanes> &lanes,
+                                     const PlannerConfig &config,
+                                     const Map &map,
+                                     const Telemetry &telemetry,
+                                     int &lane,
+                                     double &target_velocity,
+                                     VehicleTracker &tracker,
+                                     VehicleGrid &grid) {
+    int prev_size = telemetry.previous_path_x.size();
+
+    double last_s = prev_size > 0 ? telemetry.end_path_s : telemetry.s;
+    double track_length = map.get_track_length();
+    double target_distance = config.target_distance;
+
+    // Track everything first, then hash where each car will be when our path ends by s bucket and lane
+    grid.begin(track_length, NumLanes);
+    for (const SensedVehicle &cur_sense : telemetry.sensor_fusion) {
+        const VehicleTrack &track = tracker.observe(cur_sense.id, cur_sense.s, cur_sense.d, cur_sense.v_x, cur_sense.v_y);
+        double check_car_s = track.predict_s((double) prev_size * SIMULATOR_TIME_STEP);
+        grid.add(cur_sense.id, lanes.lane_index(cur_sense.d), check_car_s, cur_sense.d, track.speed);
+    }
+    grid.build();
+
+    // Anyone closing in within (behind, ahead) of where our path ends, wherever the track wraps
+    auto getting_close = [&](int sensed_lane, double behind, double ahead) {
+        return grid.any_in_window(sensed_lane, last_s - behind, behind + ahead, [&](const GridVehicle &vehicle) {
+            // How far ahead (negative if behind) of where our path ends
+            double gap = s_diff(vehicle.s, last_s, track_length);
+            return gap > -behind && gap < ahead;
+        });
+    };
+
+    bool same_lane_clear = !getting_close(lane, 0, target_distance);
+
+    // Possible improvement -- these checks will return true if the car is in lane 0,
+    // but the sensed obstacle is in lane 2, thereby preventing the car from going to 1.
+    // I would rather implement FSM than fix this issue as the car performs fairly well otherwise.
+    bool left_lane_clear = lane != 0;
+    for (int sensed_lane = -1; sensed_lane < lane && left_lane_clear; sensed_lane++) {
+        left_lane_clear = !getting_close(sensed_lane, target_distance / 3, target_distance);
+    }
+    bool right_lane_clear = lane != LaneGeometry<NumLanes>::last_lane;
+    for (int sensed_lane = lane + 1; sensed_lane <= NumLanes && right_lane_clear; sensed_lane++) {
+        right_lane_clear = !getting_close(sensed_lane, target_distance / 3, target_distance);
+    }
+
+    if (same_lane_clear) {
+        target_velocity = config.max_speed;
+    } else if (left_lane_clear) {
+        lane--;
+    } else if (right_lane_clear) {
+        lane++;
+    } else {
+        // Stuck behind someone: match their speed, less the closer they are, so the gap opens back up
+        GridNeighbor lead;
+        if (grid.nearest_ahead(lane, last_s, target_distance, lead)) {
+            double lead_velocity = lead.vehicle->speed * MPH_TO_METERS;
+            target_velocity = min(config.max_speed, lead_velocity * lead.gap / target_distance);
+        }
+    }
+}
+
+// Picks the decide_lane_and_velocity specialized for the map's lane count, see with_lane_geometry
+struct LaneDecision {
+    const PlannerConfig &config;
+    const Map &map;
+    const Telemetry &telemetry;
+    int &lane;
+    double &target_velocity;
+    VehicleTracker &tracker;
+    VehicleGrid &grid;
+
+    template<int NumLanes>
+    void operator()(const LaneGeometry<NumLanes> &lanes) const {
+        decide_lane_and_velocity(lanes, config, map, telemetry, lane, target_velocity, tracker, grid);
+    }
+};
+
+void determine_lane_and_velocity(const PlannerConfig &config,
+                                 const Map &map,
+                                 const Telemetry &telemetry,
+                                 int &lane,
+                                 double &target_velocity,
+                                 VehicleTracker &tracker,
+                                 VehicleGrid &grid) {
+    // Config validation keeps the lane count within what LaneGeometry supports
+    LaneDecision decision = {config, map, telemetry, lane, target_velocity, tracker, grid};
+    with_lane_geometry(map.get_num_lanes(), map.get_lane_width(), decision);
+}
+
+void generate_trajectory_for_lane(const PlannerConfig &config,
+                                  const Telemetry &telemetry,
+                                  const Map &map,
+                                  const int lane,
+                                  const double target_velocity,
+                                  const int num_points,
+                                  TrajectoryState &state,
+                                  vector<double> &next_x_vals,
+                                  vector<double> &next_y_vals) {
+    // Main car's localization Data
+    double car_x = telemetry.x;
+    double car_y = telemetry.y;
+    double car_s = telemetry.s;
+    double car_yaw = telemetry.yaw;
+
+    // Previous path data given to the Planner
+    const vector<double> &previous_path_x = telemetry.previous_path_x;
+    const vector<double> &previous_path_y = telemetry.previous_path_y;
+    // Previous path's end s and d values
+    double end_path_s = telemetry.end_path_s;
+
+    int prev_size = previous_path_x.size();
+    double target_distance = config.target_distance;
+
+    double last_s = prev_size > 0 ? end_path_s : car_s;
+    int map_segment = map.WaypointSegment(last_s);
+
+    // Keep going along the previous spline as long as the simulator is still driving the path we gave it,
+    // we haven't changed our mind about the lane and haven't moved on to the next stretch of road.
+    bool can_extend = state.valid
+                      && prev_size >= 2
+                      && state.lane == lane
+                      && state.map_segment == map_segment
+                      && state.x_add_on < target_distance
+                      && fabs(previous_path_x[prev_size - 1] - state.last_x) < PATH_MATCH_TOLERANCE
+                      && fabs(previous_path_y[prev_size - 1] - state.last_y) < PATH_MATCH_TOLERANCE;
+
+    // Carry on with the speed profile from the end of the path we sent last, or from where the car is now
+    bool continues = state.emitted
+                     && prev_size > 0
+                     && fabs(previous_path_x[prev_size - 1] - state.last_x) < PATH_MATCH_TOLERANCE
+                     && fabs(previous_path_y[prev_size - 1] - state.last_y) < PATH_MATCH_TOLERANCE;
+    if (!continues) {
+        state.profile = SpeedProfile();
+        state.profile.speed = telemetry.speed / MPH_TO_METERS;
+    }
+
+    if (!can_extend) {
+        // Spline anchors in the local frame: where it takes over from the previous path, one halfway to the
+        // first of three further out, the three placed further out on every fit
+        double pts_x[SPLINE_ANCHORS];
+        double pts_y[SPLINE_ANCHORS];
+
+        // ref x,y,yaw states either we will reference the starting point where car is or the previous path end point
+        double ref_x;
+        double ref_y;
+        double ref_yaw;
+        // Signed curvature the path has where the spline takes over, which it starts out with so that the
+        // acceleration across the path carries on from there rather than jumping
+        double ref_curvature = 0;
+
+        // If we're almost empty on paths, use the car as starting reference
+        if (prev_size < 2) {
+            ref_x = car_x;
+            ref_y = car_y;
+            ref_yaw = map.deg2rad(car_yaw);
+        } else {
+            ref_x = previous_path_x[prev_size - 1];
+            ref_y = previous_path_y[prev_size - 1];
+
+            if (continues && state.valid) {
+                // Heading and bend exactly where the last spline left off
+                ref_yaw = state.ref_yaw + atan(state.spline.derivative(state.x_add_on));
+                ref_curvature = spline_curvature(state.spline, state.x_add_on);
+            } else {
+                double ref_x_prev = previous_path_x[prev_size - 2];
+                double ref_y_prev = previous_path_y[prev_size - 2];
+                ref_yaw = atan2(ref_y - ref_y_prev, ref_x - ref_x_prev);
+            }
+        }
+        pts_x[0] = 0;
+        pts_y[0] = 0;
+
+        // Add some some extra space for starting reference. The sharpest bend, a lane change right where the
+        // previous path ends, comes too soon to slow down for, so the anchors are spread out instead for as long as
+        // it takes more than its share of the simulator's acceleration, or bends in faster than its share of the
+        // jerk. Bends get sharper with the square of how short they are, and come on faster with the cube.
+        double fit_speed = state.profile.speed;
+        double max_lateral_accel = MAX_LATERAL_ACCEL_SHARE * SIMULATOR_MAX_ACCEL;
+        double max_lateral_jerk = MAX_LATERAL_JERK_SHARE * SIMULATOR_MAX_JERK;
+        double spacing = target_distance;
+        for (int fit = 0; fit < MAX_SPLINE_FITS; fit++) {
+            for (int k = 1; k <= 3; k++) {
+                pair<double, double> wp = map.getLaneXY(last_s + spacing * k, lane);
+                double shift_x = wp.first - ref_x;
+                double shift_y = wp.second - ref_y;
+                pts_x[k + 1] = shift_x * cos(0 - ref_yaw) - shift_y * sin(0 - ref_yaw);
+                pts_y[k + 1] = shift_x * sin(0 - ref_yaw) + shift_y * cos(0 - ref_yaw);
+            }
+
+            // Heading along local x at the start, the halfway anchor wherever it takes to bend by ref_curvature
+            // there too. How much the spline bends at the start goes linearly with that anchor's y, so two trial
+            // fits tell where.
+            pts_x[1] = pts_x[2] / 2;
+            pts_y[1] = 0;
+            state.spline.set_points(pts_x, pts_y, SPLINE_ANCHORS, 0.);
+            double bend_at_0 = state.spline.second_derivative(0);
+            pts_y[1] = 1;
+            state.spline.set_points(pts_x, pts_y, SPLINE_ANCHORS, 0.);
+            double bend_at_1 = state.spline.second_derivative(0);
+            pts_y[1] = (ref_curvature - bend_at_0) / (bend_at_1 - bend_at_0);
+            state.spline.set_points(pts_x, pts_y, SPLINE_ANCHORS, 0.);
+
+            // Points only get placed up to about the second anchor ahead before the spline is fitted again
+            peak_spline_bends(state.spline, pts_x[3], state.peak_curvature, state.peak_curvature_rate);
+            double lateral_accel = fit_speed * fit_speed * state.peak_curvature;
+            double lateral_jerk = fit_speed * fit_speed * fit_speed * state.peak_curvature_rate;
+            if (lateral_accel <= max_lateral_accel && lateral_jerk <= max_lateral_jerk) {
+                break;
+            }
+            spacing *= max(sqrt(lateral_accel / max_lateral_accel), cbrt(lateral_jerk / max_lateral_jerk));
+        }
+
+        // Distance along the curve, filled in every ARC_LENGTH_STEP of local x as far as points get placed
+        state.arc_x.assign(1, 0.);
+        state.arc_y.assign(1, state.spline(0));
+        state.arc_length.assign(1, 0.);
+
+        state.valid = true;
+        state.lane = lane;
+        state.map_segment = map_segment;
+        state.ref_x = ref_x;
+        state.ref_y = ref_y;
+        state.ref_yaw = ref_yaw;
+        state.x_add_on = 0;
+        state.arc_add_on = 0;
+        state.arc_index = 0;
+    }
+
+    // Add all previous paths to next
+    next_x_vals.assign(begin(previous_path_x), end(previous_path_x));
+    next_y_vals.assign(begin(previous_path_y), end(previous_path_y));
+
+    double cos_yaw = cos(state.ref_yaw);
+    double sin_yaw = sin(state.ref_yaw);
+
+    double target_speed = target_velocity / MPH_TO_METERS; // converting back to meters/s, not MPH
+    // No faster than the sharpest bend ahead can be taken at, and the fastest it bends in, lane changes at speed
+    // being the sharpest
+    if (state.peak_curvature > 0) {
+        target_speed = min(target_speed, sqrt(MAX_LATERAL_ACCEL_SHARE * SIMULATOR_MAX_ACCEL / state.peak_curvature));
+    }
+    if (state.peak_curvature_rate > 0) {
+        target_speed = min(target_speed,
+                           cbrt(MAX_LATERAL_JERK_SHARE * SIMULATOR_MAX_JERK / state.peak_curvature_rate));
+    }
+
+    int points_to_add = num_points - prev_size;
+    for (int i = 1; i <= points_to_add; i++) {
+        // Speeding up or slowing down only gets what cornering leaves of the simulator's total
+        double lateral_accel = state.profile.speed * state.profile.speed
+                               * fabs(spline_curvature(state.spline, state.x_add_on));
+        double accel_left = SIMULATOR_MAX_ACCEL * SIMULATOR_MAX_ACCEL - lateral_accel * lateral_accel;
+        double max_accel = min(config.max_accel, accel_left > 0 ? sqrt(accel_left) : 0.);
+        state.profile.step(target_speed, max_accel, config.max_jerk, SIMULATOR_TIME_STEP);
+
+        // Move on along the curve by the distance to cover to the next point. Points only ever move forward,
+        // so the table is extended and searched in a single sweep for as long as the spline is kept.
+        state.arc_add_on += SIMULATOR_TIME_STEP * state.profile.speed;
+        while (state.arc_length.back() <= state.arc_add_on) {
+            double x = state.arc_x.back() + ARC_LENGTH_STEP;
+            double y = state.spline(x);
+            double dy = y - state.arc_y.back();
+            state.arc_x.push_back(x);
+            state.arc_y.push_back(y);
+            state.arc_length.push_back(state.arc_length.back() + sqrt(ARC_LENGTH_STEP * ARC_LENGTH_STEP + dy * dy));
+        }
+        while (state.arc_length[state.arc_index + 1] <= state.arc_add_on) {
+            state.arc_index++;
+        }
+
+        // The point on the spline as far in a straight line from table entry k as is left to cover past it.
+        // Interpolating along the table gets close, but bends the spacing of the points wherever they cross an
+        // entry, which the car feels as jerk, so Newton's method on the squared distance takes it the rest.
+        int k = state.arc_index;
+        double left = state.arc_add_on - state.arc_length[k];
+        double x_point = state.arc_x[k] + left / (state.arc_length[k + 1] - state.arc_length[k]) * ARC_LENGTH_STEP;
+        double y_point = state.spline(x_point);
+        for (int iteration = 0; iteration < ARC_LENGTH_ITERATIONS && left > 0; iteration++) {
+            double dx = x_point - state.arc_x[k];
+            double dy = y_point - state.arc_y[k];
+            double error = dx * dx + dy * dy - left * left;
+            x_point -= error / (2 * (dx + dy * state.spline.derivative(x_point)));
+            y_point = state.spline(x_point);
+        }
+
+        state.x_add_on = x_point;
+
+        double local_x_ref = x_point;
+        double local_y_ref = y_point;
+
+        // rotate back to normal after rotating it earlier
+        x_point = local_x_ref * cos_yaw - local_y_ref * sin_yaw;
+        y_point = local_x_ref * sin_yaw + local_y_ref * cos_yaw;
+
+
+        // Very poor naming from Q&A, x_ref looks a lot like ref_x, was stuck on that for a little!
+        x_point += state.ref_x;
+        y_point += state.ref_y;
+
+        next_x_vals.push_back(x_point);
+        next_y_vals.push_back(y_point);
+    }
+
+    if (!next_x_vals.empty()) {
+        state.last_x = next_x_vals.back();
+        state.last_y = next_y_vals.back();
+        state.emitted = true;
+    }
+}
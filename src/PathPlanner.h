@@ -0,0 +1,139 @@
+//
+// The planner proper: behavior (which lane, how fast) and trajectory generation for one car,
+// independent of how telemetry gets here, so it can run behind the websocket or in-process.
+//
+
+#ifndef PATH_PLANNING_PATH_PLANNER_H
+#define PATH_PLANNING_PATH_PLANNER_H
+
+#include <utility>
+#include <vector>
+#include "AllocationTracker.h"
+#include "CubicSpline.h"
+#include "Horizon.h"
+#include "Map.h"
+#include "SpeedProfile.h"
+#include "Telemetry.h"
+#include "VehicleGrid.h"
+#include "VehicleTracker.h"
+
+using namespace std;
+
+// Defaults for PlannerConfig
+static const double MAX_SPEED = 49.5;
+static const double MAX_ACCEL = 5.; // m/s^2 along the path, half of what the simulator allows in total
+static const double MAX_JERK = 5.;  // m/s^3 along the path
+static const int NUM_POINTS = 50; // Number of points to use in path, at most
+static const int MIN_POINTS = 25; // and at least, however little the client drives between messages
+static const double LATENCY_BUDGET_MS = 20.; // one simulator step
+static const double TARGET_DISTANCE = 30.; // How far to look ahead with path calc.
+
+static const double MPH_TO_METERS = 2.24;
+static const double PATH_MATCH_TOLERANCE = 1e-3; // in meters, path points come back through JSON so aren't bit-exact
+static const double ARC_LENGTH_STEP = .5; // in meters of local x, between entries of the spline's arc length table
+// Share of SIMULATOR_MAX_ACCEL the spline's sharpest bend may take across the path at the speed driven along it,
+// the rest is left for speeding up or slowing down there
+static const double MAX_LATERAL_ACCEL_SHARE = .8;
+// Share of SIMULATOR_MAX_JERK the spline's bends coming on may take across the path, the rest is left for the
+// speed profile's MAX_JERK along it
+static const double MAX_LATERAL_JERK_SHARE = .5;
+static const int MAX_SPLINE_FITS = 4; // spreading the spline's anchors out until its bends are gentle enough
+static const int SPLINE_ANCHORS = 5; // the end of the previous path, one halfway to the next, then three ahead
+static const int ARC_LENGTH_ITERATIONS = 2; // Newton steps placing each point its distance along the spline
+
+// What can be tuned per deployment, see Config.h for where it comes from
+struct PlannerConfig {
+    double max_speed = MAX_SPEED;               // MPH
+    double max_accel = MAX_ACCEL;               // m/s^2
+    double max_jerk = MAX_JERK;                 // m/s^3
+    int num_points = NUM_POINTS;                // longest path sent back, longer is more latency tolerant
+    int min_points = MIN_POINTS;                // shortest, see Horizon.h for what's sent in between
+    double latency_budget_ms = LATENCY_BUDGET_MS; // planning time to leave room for, more if it takes longer
+    double target_distance = TARGET_DISTANCE;   // meters, spline anchor spacing and how far ahead cars matter
+};
+
+// The reference spline from the last fit and where along it we stopped emitting points,
+// so consecutive messages can keep extending the same curve instead of refitting every time.
+struct TrajectoryState {
+    bool valid = false;
+
+    int lane;
+    int map_segment; // waypoint segment that last_s was in when fitted
+
+    CubicSpline<SPLINE_ANCHORS> spline;
+    // Local frame the spline lives in
+    double ref_x;
+    double ref_y;
+    double ref_yaw;
+
+    // Arc length along the spline at local x = k * ARC_LENGTH_STEP, from the spline's origin up to just past
+    // the last emitted point
+    vector<double> arc_x;
+    vector<double> arc_y; // the spline at arc_x
+    vector<double> arc_length;
+    double peak_curvature; // 1/m, sharpest bend of the spline up to its second anchor ahead
+    double peak_curvature_rate; // 1/m^2, and the fastest that changes along the way
+
+    double x_add_on;   // local x of the last emitted point
+    double arc_add_on; // and its distance along the spline
+    int arc_index;     // table entry at or just before arc_add_on
+    double last_x;   // map coordinates of the last emitted point
+    double last_y;
+    bool emitted = false; // whether last_x, last_y and profile are set
+
+    // Speed and acceleration at the last emitted point, where the next points carry on from
+    SpeedProfile profile;
+};
+
+// Everything the planner keeps for one car between telemetry messages
+struct PlannerState {
+    PlannerConfig config;
+
+    // start in lane 1
+    int lane = 1;
+    double target_velocity = 0; // mph, what the speed profile along the path heads for
+
+    // Map::get_generation of the map the state below was built against
+    uint64_t map_generation = 0;
+
+    // Sensed vehicles' history, kept across telemetry messages for prediction
+    VehicleTracker tracker;
+    // Where the sensed vehicles are this message, rebuilt every time but its buffers are kept
+    VehicleGrid grid;
+    // Reference spline reused between messages while lane and road segment stay the same
+    TrajectoryState trajectory;
+
+    // Path length to send, from what the client drives between messages and how long planning takes
+    HorizonController horizon;
+
+    // The path plan_path sent last, its buffers reused for the next one
+    pair<vector<double>, vector<double>> path;
+
+    // Heap allocations per stage, only counted when built with PLANNER_ALLOC_TRACKING
+    AllocationStats allocations[NUM_ALLOCATION_STAGES];
+};
+
+// Decide on lane and speed, then generate the path to send back, updating state for the next message.
+// The path is state.path, valid until the next call.
+const pair<vector<double>, vector<double>> &plan_path(const Map &map, const Telemetry &telemetry, PlannerState &state);
+
+// The previous path followed by the new points into next_x_vals and next_y_vals, replacing what was there
+void generate_trajectory_for_lane(const PlannerConfig &config,
+                                  const Telemetry &telemetry,
+                                  const Map &map,
+                                  const int lane,
+                                  const double target_velocity,
+                                  const int num_points,
+                                  TrajectoryState &state,
+                                  vector<double> &next_x_vals,
+                                  vector<double> &next_y_vals);
+
+void determine_lane_and_velocity(const PlannerConfig &config,
+                                 const Map &map,
+                                 const Telemetry &telemetry,
+                                 int &lane,
+                                 double &target_velocity,
+                                 VehicleTracker &tracker,
+                                 VehicleGrid &grid);
+
+#endif //PATH_PLANNING_PATH_PLANNER_H
@@ -0,0 +1,390 @@
+//
+// Socket.io frame serialization and the binary protocol, see Protocol.h
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "Protocol.h"
+
+using namespace std;
+
+// Same as json::dump: 15 significant digits, and ".0" on anything that would otherwise read as an integer
+static void append_number(string &frame, double value) {
+    char buffer[32];
+    int length;
+    if (value == 0) {
+        length = snprintf(buffer, sizeof(buffer), "%s", signbit(value) ? "-0.0" : "0.0");
+    } else {
+        length = snprintf(buffer, sizeof(buffer), "%.15g", value);
+        if (!strpbrk(buffer, ".eE")) {
+            buffer[length++] = '.';
+            buffer[length++] = '0';
+        }
+    }
+    frame.append(buffer, length);
+}
+
+string hasData(const char *data, size_t length) {
+    const char *end = data + length;
+    const char *null = "null";
+    if (search(data, end, null, null + 4) != end) {
+        return "";
+    }
+
+    // From the first [ to the last ], nothing outside the message is read whatever it holds
+    const char *b1 = find(data, end, '[');
+    const char *b2 = end;
+    while (b2 > b1 && *(b2 - 1) != ']') {
+        b2--;
+    }
+    if (b2 <= b1) {
+        return "";
+    }
+
+    // Nesting the way json::parse sees it, one recursion per level: brackets inside strings (escapes
+    // included) don't count, and a stray closing bracket can't make room for deeper nesting after it
+    int depth = 0;
+    bool in_string = false;
+    for (const char *c = b1; c < b2; c++) {
+        if (in_string) {
+            if (*c == '\\' && c + 1 < b2) {
+                c++;
+            } else if (*c == '"') {
+                in_string = false;
+            }
+        } else if (*c == '"') {
+            in_string = true;
+        } else if (*c == '[' || *c == '{') {
+            if (++depth > SOCKETIO_MAX_DEPTH) {
+                return "";
+            }
+        } else if ((*c == ']' || *c == '}') && depth > 0) {
+            depth--;
+        }
+    }
+    return string(b1, b2);
+}
+
+static void append_array(string &frame, const vector<double> &values) {
+    frame += '[';
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0) {
+            frame += ',';
+        }
+        append_number(frame, values[i]);
+    }
+    frame += ']';
+}
+
+void write_control_frame(string &frame, const vector<double> &next_x, const vector<double> &next_y) {
+    frame.clear();
+    frame += "42[\"control\",{\"next_x\":";
+    append_array(frame, next_x);
+    frame += ",\"next_y\":";
+    append_array(frame, next_y);
+    frame += "}]";
+}
+
+// Little-endian writers and readers, whatever the host's byte order
+
+static void put_u8(string &frame, uint8_t value) {
+    frame += (char) value;
+}
+
+static void put_u16(string &frame, uint16_t value) {
+    put_u8(frame, value & 0xff);
+    put_u8(frame, value >> 8);
+}
+
+static void put_u32(string &frame, uint32_t value) {
+    put_u16(frame, value & 0xffff);
+    put_u16(frame, value >> 16);
+}
+
+static void put_u64(string &frame, uint64_t value) {
+    put_u32(frame, value & 0xffffffff);
+    put_u32(frame, value >> 32);
+}
+
+static void put_f64(string &frame, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u64(frame, bits);
+}
+
+static void put_f32(string &frame, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u32(frame, bits);
+}
+
+// Reads stop (and ok turns false) at the end of the data instead of running past it
+struct BinaryReader {
+    const unsigned char *data;
+    size_t left;
+    bool ok = true;
+
+    BinaryReader(const char *data, size_t length) : data((const unsigned char *) data), left(length) {}
+
+    bool has(size_t bytes) {
+        ok = ok && bytes <= left;
+        return ok;
+    }
+
+    uint64_t uint(size_t bytes) {
+        if (!has(bytes)) {
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= (uint64_t) data[i] << (8 * i);
+        }
+        data += bytes;
+        left -= bytes;
+        return value;
+    }
+
+    uint8_t u8() { return (uint8_t) uint(1); }
+    uint16_t u16() { return (uint16_t) uint(2); }
+    uint32_t u32() { return (uint32_t) uint(4); }
+
+    double f64() {
+        uint64_t bits = uint(8);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    float f32() {
+        uint32_t bits = (uint32_t) uint(4);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // f32 or f64 depending on the negotiated flags
+    double real(uint8_t flags) { return flags & BINARY_FLOAT32 ? f32() : f64(); }
+};
+
+static void put_real(string &frame, double value, uint8_t flags) {
+    if (flags & BINARY_FLOAT32) {
+        put_f32(frame, (float) value);
+    } else {
+        put_f64(frame, value);
+    }
+}
+
+static void put_header(string &frame, uint8_t type, uint32_t sequence) {
+    frame.clear();
+    put_u16(frame, BINARY_MAGIC);
+    put_u8(frame, BINARY_VERSION);
+    put_u8(frame, type);
+    put_u32(frame, sequence);
+}
+
+// The points from first on
+static void put_path(string &frame, const vector<double> &xs, const vector<double> &ys, uint8_t flags, size_t first = 0) {
+    size_t end = min(xs.size(), ys.size());
+    first = min(first, end);
+    end = min(end, first + UINT16_MAX);
+    put_u16(frame, end - first);
+
+    if (!(flags & BINARY_DELTA)) {
+        for (size_t i = first; i < end; i++) {
+            put_real(frame, xs[i], flags);
+            put_real(frame, ys[i], flags);
+        }
+        return;
+    }
+
+    // Offsets are taken from what the reader will have reconstructed, so f32 rounding doesn't add up
+    double x = 0;
+    double y = 0;
+    for (size_t i = first; i < end; i++) {
+        if (i == first) {
+            x = xs[i];
+            y = ys[i];
+            put_f64(frame, x);
+            put_f64(frame, y);
+        } else {
+            float d_x = (float) (xs[i] - x);
+            float d_y = (float) (ys[i] - y);
+            x += d_x;
+            y += d_y;
+            put_f32(frame, d_x);
+            put_f32(frame, d_y);
+        }
+    }
+}
+
+// Appends to whatever xs and ys already hold
+static bool read_path(BinaryReader &reader, uint8_t flags, vector<double> &xs, vector<double> &ys) {
+    size_t count = reader.u16();
+    size_t point_size = flags & (BINARY_FLOAT32 | BINARY_DELTA) ? 8 : 16;
+    size_t first_size = flags & BINARY_DELTA ? 16 : point_size;
+    // Check up front, so a bogus count can't make us allocate for points that aren't there
+    if (count > 0 && !reader.has(first_size + (count - 1) * point_size)) {
+        return false;
+    }
+
+    double x = 0;
+    double y = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!(flags & BINARY_DELTA)) {
+            x = reader.real(flags);
+            y = reader.real(flags);
+        } else if (i == 0) {
+            x = reader.f64();
+            y = reader.f64();
+        } else {
+            x += reader.f32();
+            y += reader.f32();
+        }
+        xs.push_back(x);
+        ys.push_back(y);
+    }
+
+    return reader.ok;
+}
+
+bool read_binary_header(const char *data, size_t length, BinaryHeader &header) {
+    BinaryReader reader(data, length);
+    uint16_t magic = reader.u16();
+    uint8_t version = reader.u8();
+    header.type = reader.u8();
+    header.sequence = reader.u32();
+    return reader.ok && magic == BINARY_MAGIC && version == BINARY_VERSION;
+}
+
+void write_binary_hello(string &frame, uint8_t type, uint8_t flags) {
+    put_header(frame, type, 0);
+    put_u8(frame, flags);
+}
+
+bool read_binary_hello(const char *data, size_t length, uint8_t &flags) {
+    BinaryReader reader(data + BINARY_HEADER_SIZE, length < BINARY_HEADER_SIZE ? 0 : length - BINARY_HEADER_SIZE);
+    flags = reader.u8();
+    return length >= BINARY_HEADER_SIZE && reader.ok;
+}
+
+void write_binary_telemetry(string &frame, const Telemetry &telemetry, uint8_t flags, uint32_t sequence) {
+    put_header(frame, BINARY_TELEMETRY, sequence);
+    put_f64(frame, telemetry.x);
+    put_f64(frame, telemetry.y);
+    put_f64(frame, telemetry.s);
+    put_f64(frame, telemetry.d);
+    put_f64(frame, telemetry.yaw);
+    put_f64(frame, telemetry.speed);
+    put_f64(frame, telemetry.end_path_s);
+    put_f64(frame, telemetry.end_path_d);
+
+    put_path(frame, telemetry.previous_path_x, telemetry.previous_path_y, flags);
+
+    size_t count = min(telemetry.sensor_fusion.size(), (size_t) UINT16_MAX);
+    put_u16(frame, count);
+    for (size_t i = 0; i < count; i++) {
+        const SensedVehicle &vehicle = telemetry.sensor_fusion[i];
+        put_u32(frame, (uint32_t) vehicle.id);
+        put_real(frame, vehicle.x, flags);
+        put_real(frame, vehicle.y, flags);
+        put_real(frame, vehicle.v_x, flags);
+        put_real(frame, vehicle.v_y, flags);
+        put_real(frame, vehicle.s, flags);
+        put_real(frame, vehicle.d, flags);
+    }
+}
+
+bool read_binary_telemetry(const char *data, size_t length, uint8_t flags, Telemetry &telemetry) {
+    if (length < BINARY_HEADER_SIZE) {
+        return false;
+    }
+    BinaryReader reader(data + BINARY_HEADER_SIZE, length - BINARY_HEADER_SIZE);
+
+    telemetry.x = reader.f64();
+    telemetry.y = reader.f64();
+    telemetry.s = reader.f64();
+    telemetry.d = reader.f64();
+    telemetry.yaw = reader.f64();
+    telemetry.speed = reader.f64();
+    telemetry.end_path_s = reader.f64();
+    telemetry.end_path_d = reader.f64();
+
+    telemetry.previous_path_x.clear();
+    telemetry.previous_path_y.clear();
+    if (!read_path(reader, flags, telemetry.previous_path_x, telemetry.previous_path_y)) {
+        return false;
+    }
+
+    size_t count = reader.u16();
+    size_t vehicle_size = 4 + 6 * (flags & BINARY_FLOAT32 ? 4 : 8);
+    if (!reader.has(count * vehicle_size)) {
+        return false;
+    }
+
+    telemetry.sensor_fusion.clear();
+    for (size_t i = 0; i < count; i++) {
+        SensedVehicle vehicle;
+        vehicle.id = (int32_t) reader.u32();
+        vehicle.x = reader.real(flags);
+        vehicle.y = reader.real(flags);
+        vehicle.v_x = reader.real(flags);
+        vehicle.v_y = reader.real(flags);
+        vehicle.s = reader.real(flags);
+        vehicle.d = reader.real(flags);
+        telemetry.sensor_fusion.push_back(vehicle);
+    }
+
+    return reader.ok;
+}
+
+size_t count_kept_points(const vector<double> &next_x,
+                         const vector<double> &next_y,
+                         const vector<double> &previous_x,
+                         const vector<double> &previous_y) {
+    size_t count = min(min(next_x.size(), next_y.size()), min(previous_x.size(), previous_y.size()));
+    size_t kept = 0;
+    while (kept < count && next_x[kept] == previous_x[kept] && next_y[kept] == previous_y[kept]) {
+        kept++;
+    }
+    return min(kept, (size_t) UINT16_MAX);
+}
+
+void write_binary_control(string &frame,
+                          const vector<double> &next_x,
+                          const vector<double> &next_y,
+                          uint8_t flags,
+                          uint32_t sequence,
+                          size_t kept) {
+    put_header(frame, BINARY_CONTROL, sequence);
+
+    if (!(flags & BINARY_TAIL)) {
+        put_path(frame, next_x, next_y, flags);
+        return;
+    }
+
+    kept = min(kept, min(min(next_x.size(), next_y.size()), (size_t) UINT16_MAX));
+    put_u16(frame, kept);
+    put_path(frame, next_x, next_y, flags, kept);
+}
+
+bool read_binary_control(const char *data, size_t length, uint8_t flags, vector<double> &next_x, vector<double> &next_y) {
+    if (length < BINARY_HEADER_SIZE) {
+        return false;
+    }
+    BinaryReader reader(data + BINARY_HEADER_SIZE, length - BINARY_HEADER_SIZE);
+
+    size_t kept = 0;
+    if (flags & BINARY_TAIL) {
+        kept = reader.u16();
+        // Can't keep points of a previous path we don't have
+        if (!reader.ok || kept > next_x.size() || kept > next_y.size()) {
+            return false;
+        }
+    }
+    next_x.resize(kept);
+    next_y.resize(kept);
+
+    return read_path(reader, flags, next_x, next_y);
+}
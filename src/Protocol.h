@@ -0,0 +1,100 @@
+//
+// Socket.io text frames we send back to the simulator, written straight into reusable buffers
+// rather than built up from json objects and temporary strings.
+//
+// Alongside them, a compact binary protocol for our own clients, sent as binary websocket frames.
+// Every message is a fixed layout little-endian record starting with an 8 byte header:
+//
+//   u16 magic 'PP' | u8 version | u8 type | u32 sequence
+//
+// A client opts in by sending HELLO with the flags it wants (u8), the server answers HELLO_ACK with the
+// flags it accepted. After that the client sends TELEMETRY and gets CONTROL back, echoing its sequence:
+//
+//   TELEMETRY: f64 x, y, s, d, yaw, speed, end_path_s, end_path_d | path | u16 count, count * vehicle
+//              vehicle: i32 id | f64 x, y, v_x, v_y, s, d (f32 with BINARY_FLOAT32)
+//   CONTROL:   path, or with BINARY_TAIL: u16 kept | path
+//   path:      u16 count | count * (x, y)
+//
+// Path points are f64, or f32 with BINARY_FLOAT32. With BINARY_DELTA the first point stays f64 and every
+// following one is an f32 offset from the one before, at well under a millimeter of error over a path.
+//
+// Most ticks the planner only appends a few points to the previous path it was sent. With BINARY_TAIL a
+// CONTROL only carries those: the new path is the first `kept` points of the previous path in the
+// telemetry with the same sequence number, followed by the points in the message.
+//
+
+#ifndef PATH_PLANNING_PROTOCOL_H
+#define PATH_PLANNING_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Telemetry.h"
+
+using namespace std;
+
+// Deepest nesting of arrays and objects hasData lets through, telemetry needs 4 and json::parse recurses
+// once per level, so a frame of nothing but brackets can't run it out of stack
+static const int SOCKETIO_MAX_DEPTH = 32;
+
+// Checks if the SocketIO event in the length bytes at data (not null terminated) has JSON data.
+// If there is data the JSON array in string format will be returned,
+// else the empty string "" will be returned, also for data nested deeper than SOCKETIO_MAX_DEPTH.
+string hasData(const char *data, size_t length);
+
+// Serialize 42["control",{"next_x":[...],"next_y":[...]}] into frame, replacing what was there but keeping
+// its capacity. Numbers are formatted the way json::dump does, so the simulator sees the same text as before.
+void write_control_frame(string &frame, const vector<double> &next_x, const vector<double> &next_y);
+
+static const uint16_t BINARY_MAGIC = 0x5050; // "PP"
+static const uint8_t BINARY_VERSION = 1;
+static const size_t BINARY_HEADER_SIZE = 8;
+
+enum BinaryMessageType : uint8_t {
+    BINARY_HELLO = 1,
+    BINARY_HELLO_ACK = 2,
+    BINARY_TELEMETRY = 3,
+    BINARY_CONTROL = 4
+};
+
+// Negotiated encoding options
+static const uint8_t BINARY_FLOAT32 = 1;
+static const uint8_t BINARY_DELTA = 2;
+static const uint8_t BINARY_TAIL = 4;
+static const uint8_t BINARY_SUPPORTED_FLAGS = BINARY_FLOAT32 | BINARY_DELTA | BINARY_TAIL;
+
+struct BinaryHeader {
+    uint8_t type;
+    uint32_t sequence;
+};
+
+// false if data doesn't start with a header for our magic and version
+bool read_binary_header(const char *data, size_t length, BinaryHeader &header);
+
+// HELLO and HELLO_ACK
+void write_binary_hello(string &frame, uint8_t type, uint8_t flags);
+bool read_binary_hello(const char *data, size_t length, uint8_t &flags);
+
+void write_binary_telemetry(string &frame, const Telemetry &telemetry, uint8_t flags, uint32_t sequence);
+// false if the record is truncated or malformed, telemetry may be partially filled then
+bool read_binary_telemetry(const char *data, size_t length, uint8_t flags, Telemetry &telemetry);
+
+// How many leading points of the next path are the previous path's, unchanged
+size_t count_kept_points(const vector<double> &next_x,
+                         const vector<double> &next_y,
+                         const vector<double> &previous_x,
+                         const vector<double> &previous_y);
+
+// With BINARY_TAIL only the points after the first kept ones are written
+void write_binary_control(string &frame,
+                          const vector<double> &next_x,
+                          const vector<double> &next_y,
+                          uint8_t flags,
+                          uint32_t sequence,
+                          size_t kept = 0);
+// With BINARY_TAIL next_x/next_y have to hold the previous path sent with that sequence number on the way in,
+// they are cut down to the kept points and the tail is appended
+bool read_binary_control(const char *data, size_t length, uint8_t flags, vector<double> &next_x, vector<double> &next_y);
+
+#endif //PATH_PLANNING_PROTOCOL_H
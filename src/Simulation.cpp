@@ -0,0 +1,283 @@
+//
+// Headless highway simulation, see Simulation.h
+//
+
+#include <algorithm>
+#include <math.h>
+#include "Frenet.h"
+#include "Simulation.h"
+
+using namespace std;
+
+Simulation::Simulation(const Map &map, int num_egos, int num_traffic, unsigned int seed)
+        : map(map), track_length(map.get_track_length()), rng(seed) {
+    // Spread the egos evenly around the track, the first one where the simulator starts its car
+    for (int i = 0; i < num_egos; i++) {
+        EgoCar ego;
+        ego.id = num_traffic + i;
+        ego.s = wrap_s(124.8 + i * track_length / num_egos, track_length);
+        ego.d = map.lane_center(min(1, map.get_num_lanes() - 1));
+        pair<double, double> xy = map.getXY(ego.s, ego.d);
+        pair<double, double> ahead = map.getXY(ego.s + 1, ego.d);
+        ego.x = xy.first;
+        ego.y = xy.second;
+        ego.yaw = map.rad2deg(atan2(ahead.second - xy.second, ahead.first - xy.first));
+        ego.speed = 0;
+        egos.push_back(ego);
+    }
+
+    uniform_real_distribution<double> random_s(0, track_length);
+    uniform_int_distribution<int> random_lane(0, map.get_num_lanes() - 1);
+    uniform_real_distribution<double> random_speed(TRAFFIC_MIN_SPEED, TRAFFIC_MAX_SPEED);
+
+    for (int i = 0; i < num_traffic; i++) {
+        TrafficCar car;
+        car.id = i;
+        car.lane = random_lane(rng);
+        car.d = map.lane_center(car.lane);
+        car.target_speed = random_speed(rng);
+        car.speed = car.target_speed;
+
+        // Don't drop anyone right on top of an ego car
+        bool too_close;
+        do {
+            car.s = random_s(rng);
+            too_close = false;
+            for (const EgoCar &ego : egos) {
+                if (fabs(s_diff(car.s, ego.s, track_length)) < 30) {
+                    too_close = true;
+                }
+            }
+        } while (too_close);
+
+        traffic.push_back(car);
+    }
+}
+
+bool Simulation::vehicle_ahead(double s, int lane, int skip_traffic_id, double &gap, double &speed) const {
+    double lane_left = map.get_lane_width() * lane;
+    double lane_right = lane_left + map.get_lane_width();
+    bool found = false;
+
+    for (const TrafficCar &car : traffic) {
+        if (car.id == skip_traffic_id || !((car.d > lane_left && car.d < lane_right) || car.lane == lane)) {
+            continue;
+        }
+        double car_gap = s_diff(car.s, s, track_length);
+        if (car_gap > 0 && (!found || car_gap < gap)) {
+            found = true;
+            gap = car_gap;
+            speed = car.speed;
+        }
+    }
+
+    for (const EgoCar &ego : egos) {
+        if (ego.d < lane_left || ego.d > lane_right) {
+            continue;
+        }
+        double ego_gap = s_diff(ego.s, s, track_length);
+        if (ego_gap > 0 && (!found || ego_gap < gap)) {
+            found = true;
+            gap = ego_gap;
+            speed = ego.speed / MS_TO_MPH;
+        }
+    }
+
+    return found;
+}
+
+bool Simulation::lane_is_free(double s, int lane, int skip_traffic_id) const {
+    double lane_left = map.get_lane_width() * lane;
+    double lane_right = lane_left + map.get_lane_width();
+
+    for (const TrafficCar &car : traffic) {
+        if (car.id != skip_traffic_id && ((car.d > lane_left && car.d < lane_right) || car.lane == lane)
+            && s_in_window(car.s, s - 15, 45, track_length)) {
+            return false;
+        }
+    }
+    for (const EgoCar &ego : egos) {
+        if (ego.d > lane_left && ego.d < lane_right && s_in_window(ego.s, s - 15, 45, track_length)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Simulation::move_traffic() {
+    uniform_real_distribution<double> chance(0, 1);
+
+    for (TrafficCar &car : traffic) {
+        double gap;
+        double ahead_speed;
+        double accel = (car.target_speed - car.speed) / 2;
+
+        if (vehicle_ahead(car.s, car.lane, car.id, gap, ahead_speed)) {
+            double desired_gap = CAR_LENGTH + 2 + car.speed * TRAFFIC_TIME_HEADWAY;
+            if (gap < 2 * desired_gap) {
+                // Match the car ahead's speed while closing in on the desired gap
+                accel = min(accel, (ahead_speed - car.speed) + (gap - desired_gap) / TRAFFIC_TIME_HEADWAY);
+            }
+        }
+
+        accel = max(-TRAFFIC_MAX_DECEL, min(TRAFFIC_MAX_ACCEL, accel));
+        car.speed = max(0., car.speed + accel * SIMULATOR_TIME_STEP);
+        car.s = wrap_s(car.s + car.speed * SIMULATOR_TIME_STEP, track_length);
+
+        double lane_center = map.lane_center(car.lane);
+        bool changing_lanes = fabs(car.d - lane_center) > 1e-6;
+        if (changing_lanes) {
+            double max_move = map.get_lane_width() / TRAFFIC_LANE_CHANGE_TIME * SIMULATOR_TIME_STEP;
+            car.d += max(-max_move, min(max_move, lane_center - car.d));
+        } else if (car.speed < car.target_speed - 2 && chance(rng) < .01) {
+            // Stuck behind someone, try to get around them
+            int other_lane = car.lane + (chance(rng) < .5 ? -1 : 1);
+            if (other_lane >= 0 && other_lane < map.get_num_lanes() && lane_is_free(car.s, other_lane, car.id)) {
+                car.lane = other_lane;
+            }
+        }
+    }
+}
+
+void Simulation::move_ego(EgoCar &ego) {
+    if (ego.path_pos >= ego.path_x.size()) {
+        // Nothing left to drive, the car just stands where it is
+        ego.starved_steps++;
+        ego.v_x = 0;
+        ego.v_y = 0;
+        ego.speed = 0;
+        return;
+    }
+
+    double next_x = ego.path_x[ego.path_pos];
+    double next_y = ego.path_y[ego.path_pos];
+    ego.path_pos++;
+
+    double v_x = (next_x - ego.x) / SIMULATOR_TIME_STEP;
+    double v_y = (next_y - ego.y) / SIMULATOR_TIME_STEP;
+    double a_x = (v_x - ego.v_x) / SIMULATOR_TIME_STEP;
+    double a_y = (v_y - ego.v_y) / SIMULATOR_TIME_STEP;
+
+    // Need a couple of moves before velocity and acceleration differences mean anything
+    ego.moves++;
+    if (ego.moves > 1) {
+        ego.max_accel = max(ego.max_accel, sqrt(a_x * a_x + a_y * a_y));
+    }
+    if (ego.moves > 2) {
+        double j_x = (a_x - ego.a_x) / SIMULATOR_TIME_STEP;
+        double j_y = (a_y - ego.a_y) / SIMULATOR_TIME_STEP;
+        ego.max_jerk = max(ego.max_jerk, sqrt(j_x * j_x + j_y * j_y));
+    }
+
+    double step_distance = sqrt((next_x - ego.x) * (next_x - ego.x) + (next_y - ego.y) * (next_y - ego.y));
+    if (step_distance > 1e-6) {
+        ego.yaw = map.rad2deg(atan2(next_y - ego.y, next_x - ego.x));
+    }
+
+    ego.x = next_x;
+    ego.y = next_y;
+    ego.v_x = v_x;
+    ego.v_y = v_y;
+    ego.a_x = a_x;
+    ego.a_y = a_y;
+    ego.speed = step_distance / SIMULATOR_TIME_STEP * MS_TO_MPH;
+    ego.distance += step_distance;
+
+    pair<double, double> frenet = ego.frenet.getFrenet(map, ego.x, ego.y);
+    ego.s = frenet.first;
+    ego.d = frenet.second;
+
+    if (ego.speed > SPEED_LIMIT_MPH) {
+        ego.speeding_steps++;
+    }
+    if (ego.d < 0 || ego.d > map.get_lane_width() * map.get_num_lanes()) {
+        ego.out_of_lane_steps++;
+    }
+}
+
+void Simulation::check_collisions(EgoCar &ego) {
+    bool colliding = false;
+
+    for (const TrafficCar &car : traffic) {
+        if (fabs(s_diff(car.s, ego.s, track_length)) < CAR_LENGTH && fabs(car.d - ego.d) < CAR_WIDTH) {
+            colliding = true;
+        }
+    }
+    for (const EgoCar &other : egos) {
+        if (other.id != ego.id && fabs(s_diff(other.s, ego.s, track_length)) < CAR_LENGTH
+            && fabs(other.d - ego.d) < CAR_WIDTH) {
+            colliding = true;
+        }
+    }
+
+    // Count each crash once, not every step the cars overlap
+    if (colliding && !ego.colliding) {
+        ego.collisions++;
+    }
+    ego.colliding = colliding;
+}
+
+void Simulation::step() {
+    move_traffic();
+    for (EgoCar &ego : egos) {
+        move_ego(ego);
+    }
+    for (EgoCar &ego : egos) {
+        check_collisions(ego);
+    }
+
+    time += SIMULATOR_TIME_STEP;
+}
+
+void Simulation::add_sensed(SensedVehicle vehicle, double ego_s, Telemetry &telemetry) const {
+    if (fabs(s_diff(vehicle.s, ego_s, track_length)) <= SENSOR_RANGE) {
+        telemetry.sensor_fusion.push_back(vehicle);
+    }
+}
+
+void Simulation::telemetry(int i, Telemetry &telemetry) const {
+    const EgoCar &ego = egos[i];
+
+    telemetry.x = ego.x;
+    telemetry.y = ego.y;
+    telemetry.s = ego.s;
+    telemetry.d = ego.d;
+    telemetry.yaw = ego.yaw;
+    telemetry.speed = ego.speed;
+
+    telemetry.previous_path_x.assign(ego.path_x.begin() + ego.path_pos, ego.path_x.end());
+    telemetry.previous_path_y.assign(ego.path_y.begin() + ego.path_pos, ego.path_y.end());
+    bool has_path = ego.path_pos < ego.path_x.size();
+    telemetry.end_path_s = has_path ? ego.end_path_s : 0;
+    telemetry.end_path_d = has_path ? ego.end_path_d : 0;
+
+    telemetry.sensor_fusion.clear();
+    for (const TrafficCar &car : traffic) {
+        pair<double, double> xy = map.getXY(car.s, car.d);
+        pair<double, double> ahead = map.getXY(car.s + 1, car.d);
+        double heading = atan2(ahead.second - xy.second, ahead.first - xy.first);
+        add_sensed({car.id, xy.first, xy.second, car.speed * cos(heading), car.speed * sin(heading), car.s, car.d},
+                   ego.s, telemetry);
+    }
+    for (const EgoCar &other : egos) {
+        if (other.id != ego.id) {
+            add_sensed({other.id, other.x, other.y, other.v_x, other.v_y, other.s, other.d}, ego.s, telemetry);
+        }
+    }
+}
+
+void Simulation::control(int i, const vector<double> &next_x, const vector<double> &next_y) {
+    EgoCar &ego = egos[i];
+
+    size_t size = min(next_x.size(), next_y.size());
+    ego.path_x.assign(next_x.begin(), next_x.begin() + size);
+    ego.path_y.assign(next_y.begin(), next_y.begin() + size);
+    ego.path_pos = 0;
+
+    if (size > 0) {
+        pair<double, double> frenet = ego.end_path_frenet.getFrenet(map, next_x[size - 1], next_y[size - 1]);
+        ego.end_path_s = frenet.first;
+        ego.end_path_d = frenet.second;
+    }
+}
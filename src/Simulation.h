@@ -0,0 +1,118 @@
+//
+// Stand-in for the Unity simulator: ego cars that drive exactly the paths they are given, plus background
+// traffic that follows the car ahead and changes lanes now and then. Runs in lockstep with whoever drives
+// it, so it goes as fast as the planner can answer rather than in real time.
+//
+
+#ifndef PATH_PLANNING_SIMULATION_H
+#define PATH_PLANNING_SIMULATION_H
+
+#include <random>
+#include <vector>
+#include "FrenetTracker.h"
+#include "Map.h"
+#include "Telemetry.h"
+
+using namespace std;
+
+static const double MS_TO_MPH = 2.23694;
+
+static const double SPEED_LIMIT_MPH = 50.;
+static const double CAR_LENGTH = 5.;   // meters, bumper to bumper distance that counts as a collision
+static const double CAR_WIDTH = 2.;    // meters, same sideways
+static const double SENSOR_RANGE = 200.; // meters ahead and behind that sensor fusion reports cars in
+
+// Background traffic drives +-10 MPH around the speed limit, like in the simulator
+static const double TRAFFIC_MIN_SPEED = 40. / MS_TO_MPH;
+static const double TRAFFIC_MAX_SPEED = 55. / MS_TO_MPH;
+static const double TRAFFIC_MAX_ACCEL = 2.;    // m/s^2
+static const double TRAFFIC_MAX_DECEL = 6.;    // m/s^2
+static const double TRAFFIC_TIME_HEADWAY = 1.5; // seconds kept to the car ahead
+static const double TRAFFIC_LANE_CHANGE_TIME = 3.; // seconds to move over one lane
+
+struct TrafficCar {
+    int id;
+    double s;
+    double d;
+    double speed;        // m/s
+    double target_speed; // m/s
+    int lane;            // lane it's in or moving into
+};
+
+struct EgoCar {
+    int id;
+
+    // Where the car is now
+    double x;
+    double y;
+    double s;
+    double d;
+    double yaw;   // degrees
+    double speed; // MPH
+    FrenetTracker frenet;
+
+    // What's left of the last path it was given
+    vector<double> path_x;
+    vector<double> path_y;
+    size_t path_pos = 0;
+    double end_path_s = 0;
+    double end_path_d = 0;
+    FrenetTracker end_path_frenet;
+
+    // Velocity and acceleration from the previous step, for acceleration and jerk
+    double v_x = 0;
+    double v_y = 0;
+    double a_x = 0;
+    double a_y = 0;
+    int moves = 0;
+
+    // Collected while driving
+    double distance = 0;
+    int collisions = 0;
+    bool colliding = false;
+    int speeding_steps = 0;
+    int out_of_lane_steps = 0;
+    int starved_steps = 0; // steps where it had no path left to drive
+    double max_accel = 0;
+    double max_jerk = 0;
+};
+
+class Simulation {
+
+private:
+    const Map &map;
+    double track_length;
+
+    vector<TrafficCar> traffic;
+    vector<EgoCar> egos;
+    double time = 0;
+    mt19937 rng;
+
+    void move_traffic();
+    void move_ego(EgoCar &ego);
+    void check_collisions(EgoCar &ego);
+
+    // Closest vehicle (traffic or ego) ahead of s within the given lane's bounds, gap is set to how far
+    bool vehicle_ahead(double s, int lane, int skip_traffic_id, double &gap, double &speed) const;
+    bool lane_is_free(double s, int lane, int skip_traffic_id) const;
+
+    void add_sensed(SensedVehicle vehicle, double ego_s, Telemetry &telemetry) const;
+
+public:
+    Simulation(const Map &map, int num_egos, int num_traffic, unsigned int seed);
+
+    int num_egos() const { return egos.size(); }
+    const EgoCar &ego(int i) const { return egos[i]; }
+    double elapsed() const { return time; }
+
+    // What ego car i's planner gets to see right now
+    void telemetry(int ego, Telemetry &telemetry) const;
+
+    // A new path for ego car i to drive, replacing whatever was left of the previous one
+    void control(int ego, const vector<double> &next_x, const vector<double> &next_y);
+
+    // Advance the world by one SIMULATOR_TIME_STEP
+    void step();
+};
+
+#endif //PATH_PLANNING_SIMULATION_H
@@ -0,0 +1,50 @@
+//
+// Jerk-limited speed control along the path: every point moves speed towards a target with bounded
+// acceleration and bounded change in acceleration, easing off early enough to arrive at the target
+// speed with zero acceleration rather than overshooting it (an S-curve velocity profile).
+//
+
+#ifndef PATH_PLANNING_SPEED_PROFILE_H
+#define PATH_PLANNING_SPEED_PROFILE_H
+
+#include <math.h>
+
+struct SpeedProfile {
+    double speed = 0; // m/s
+    double accel = 0; // m/s^2
+
+    // Advance by dt towards target_speed (m/s)
+    void step(double target_speed, double max_accel, double max_jerk, double dt) {
+        double speed_error = target_speed - speed;
+
+        // Most acceleration that can still be jerked back down to 0 by the time speed reaches the target, stepping
+        // it down by max_step every dt, a * (a + max_step) / (2 * max_jerk) being the speed gained while doing that.
+        // The continuous a^2 / (2 * max_jerk) starts easing off a step late and arrives with acceleration to spare.
+        double max_step = max_jerk * dt;
+        double previous_accel = accel;
+        double wanted = (sqrt(max_step * max_step + 8 * max_jerk * fabs(speed_error)) - max_step) / 2;
+        wanted = wanted < max_accel ? wanted : max_accel;
+        if (speed_error < 0) {
+            wanted = -wanted;
+        }
+
+        accel = wanted > accel + max_step ? accel + max_step : (wanted < accel - max_step ? accel - max_step : wanted);
+        // max_accel can shrink from one step to the next (what's left of a total once cornering takes its share),
+        // staying within it comes before the jerk limit
+        accel = accel > max_accel ? max_accel : (accel < -max_accel ? -max_accel : accel);
+
+        double next_speed = speed + accel * dt;
+        // Only a step's worth of acceleration is left close to the target, don't let it carry past it but land on it.
+        // Unless that takes more than a step's worth, when the target moved while heading the other way: then
+        // carry past it and turn around within the jerk limit.
+        double landing_accel = (target_speed - speed) / dt;
+        if ((next_speed - target_speed) * (speed - target_speed) < 0
+            && fabs(landing_accel - previous_accel) <= max_step) {
+            next_speed = target_speed;
+            accel = landing_accel;
+        }
+        speed = next_speed > 0 ? next_speed : 0;
+    }
+};
+
+#endif //PATH_PLANNING_SPEED_PROFILE_H
@@ -0,0 +1,119 @@
+//
+// JSON to Telemetry decoding.
+//
+
+#include <limits>
+#include <math.h>
+#include <stdexcept>
+#include "Telemetry.h"
+
+using namespace std;
+
+// Positions of the values in each sensor fusion entry, format is [ id, x, y, vx, vy, s, d]
+struct SF_CONSTANTS {
+    explicit SF_CONSTANTS(){};
+
+    static const int id = 0;
+    static const int x = 1;
+    static const int y = 2;
+    static const int v_x = 3;
+    static const int v_y = 4;
+    static const int s = 5;
+    static const int d = 6;
+};
+
+static const struct SF_CONSTANTS SENSOR_FUSION_IDX;
+
+void decode_telemetry(const json &data, Telemetry &telemetry) {
+    // at() rather than [], which is undefined for a missing key or index on a const json
+    telemetry.x = data.at("x");
+    telemetry.y = data.at("y");
+    telemetry.s = data.at("s");
+    telemetry.d = data.at("d");
+    telemetry.yaw = data.at("yaw");
+    telemetry.speed = data.at("speed");
+
+    const json &previous_path_x = data.at("previous_path_x");
+    const json &previous_path_y = data.at("previous_path_y");
+    telemetry.previous_path_x.clear();
+    telemetry.previous_path_y.clear();
+    for (const json &x : previous_path_x) {
+        telemetry.previous_path_x.push_back(x);
+    }
+    for (const json &y : previous_path_y) {
+        telemetry.previous_path_y.push_back(y);
+    }
+
+    telemetry.end_path_s = data.at("end_path_s");
+    telemetry.end_path_d = data.at("end_path_d");
+
+    telemetry.sensor_fusion.clear();
+    for (const json &cur_sense : data.at("sensor_fusion")) {
+        SensedVehicle vehicle;
+        // Read as a number first, converting a double outside int's range straight to int is undefined
+        double id = cur_sense.at(SENSOR_FUSION_IDX.id);
+        if (!(id >= numeric_limits<int>::min() && id <= numeric_limits<int>::max())) {
+            throw out_of_range("sensor fusion id out of range");
+        }
+        vehicle.id = (int) id;
+        vehicle.x = cur_sense.at(SENSOR_FUSION_IDX.x);
+        vehicle.y = cur_sense.at(SENSOR_FUSION_IDX.y);
+        vehicle.v_x = cur_sense.at(SENSOR_FUSION_IDX.v_x);
+        vehicle.v_y = cur_sense.at(SENSOR_FUSION_IDX.v_y);
+        vehicle.s = cur_sense.at(SENSOR_FUSION_IDX.s);
+        vehicle.d = cur_sense.at(SENSOR_FUSION_IDX.d);
+        telemetry.sensor_fusion.push_back(vehicle);
+    }
+}
+
+static bool plausible(double value) {
+    return fabs(value) <= TELEMETRY_MAX_VALUE; // false for NaN too
+}
+
+bool valid_telemetry(const Telemetry &telemetry) {
+    if (!plausible(telemetry.x) || !plausible(telemetry.y) || !plausible(telemetry.s) || !plausible(telemetry.d)
+        || !plausible(telemetry.yaw) || !plausible(telemetry.speed)
+        || !plausible(telemetry.end_path_s) || !plausible(telemetry.end_path_d)) {
+        return false;
+    }
+
+    if (telemetry.previous_path_x.size() != telemetry.previous_path_y.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < telemetry.previous_path_x.size(); i++) {
+        if (!plausible(telemetry.previous_path_x[i]) || !plausible(telemetry.previous_path_y[i])) {
+            return false;
+        }
+    }
+
+    for (const SensedVehicle &vehicle : telemetry.sensor_fusion) {
+        if (!plausible(vehicle.x) || !plausible(vehicle.y) || !plausible(vehicle.v_x) || !plausible(vehicle.v_y)
+            || !plausible(vehicle.s) || !plausible(vehicle.d)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+json encode_telemetry(const Telemetry &telemetry) {
+    json data;
+    data["x"] = telemetry.x;
+    data["y"] = telemetry.y;
+    data["s"] = telemetry.s;
+    data["d"] = telemetry.d;
+    data["yaw"] = telemetry.yaw;
+    data["speed"] = telemetry.speed;
+    data["previous_path_x"] = telemetry.previous_path_x;
+    data["previous_path_y"] = telemetry.previous_path_y;
+    data["end_path_s"] = telemetry.end_path_s;
+    data["end_path_d"] = telemetry.end_path_d;
+
+    json sensor_fusion = json::array();
+    for (const SensedVehicle &vehicle : telemetry.sensor_fusion) {
+        sensor_fusion.push_back({vehicle.id, vehicle.x, vehicle.y, vehicle.v_x, vehicle.v_y, vehicle.s, vehicle.d});
+    }
+    data["sensor_fusion"] = sensor_fusion;
+
+    return data;
+}
@@ -0,0 +1,67 @@
+//
+// Telemetry message from the simulator, decoded out of JSON once so the planner
+// (and the queues feeding it) work with plain values.
+//
+
+#ifndef PATH_PLANNING_TELEMETRY_H
+#define PATH_PLANNING_TELEMETRY_H
+
+#include <vector>
+#include "Json.h"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+static const double SIMULATOR_TIME_STEP = .02; // Num seconds between each point that the simulator drives
+static const double SIMULATOR_MAX_ACCEL = 10.; // m/s^2, along and across the path together, before it complains
+static const double SIMULATOR_MAX_JERK = 10.; // m/s^3, likewise
+// Largest magnitude of any telemetry value (meters, m/s, degrees or MPH) valid_telemetry lets through,
+// far beyond any real road while keeping the planner's arithmetic nowhere near overflowing
+static const double TELEMETRY_MAX_VALUE = 1e7;
+
+// One entry of sensor fusion, a car on the same side of the road
+struct SensedVehicle {
+    int id;
+    double x;
+    double y;
+    double v_x; // m/s
+    double v_y; // m/s
+    double s;
+    double d;
+};
+
+struct Telemetry {
+    // Main car's localization Data
+    double x;
+    double y;
+    double s;
+    double d;
+    double yaw;   // degrees
+    double speed; // MPH
+
+    // Previous path data given to the Planner, with the points already driven removed
+    vector<double> previous_path_x;
+    vector<double> previous_path_y;
+    // Previous path's end s and d values
+    double end_path_s;
+    double end_path_d;
+
+    // Sensor Fusion Data, a list of all other cars on the same side of the road.
+    vector<SensedVehicle> sensor_fusion;
+};
+
+// Decode the data object of a telemetry event. Reuses the vectors already in telemetry,
+// so decoding into the same struct every message doesn't allocate once they've grown.
+// Throws (a json exception) on a missing key or a value of the wrong type, and out_of_range
+// on a sensor fusion id that doesn't fit an int.
+void decode_telemetry(const json &data, Telemetry &telemetry);
+
+// Whether telemetry is safe to plan with: every value finite and within TELEMETRY_MAX_VALUE, and as many
+// previous path x's as y's. Decoding only checks the format, this checks the numbers.
+bool valid_telemetry(const Telemetry &telemetry);
+
+// The other direction, producing the data object the simulator would send
+json encode_telemetry(const Telemetry &telemetry);
+
+#endif //PATH_PLANNING_TELEMETRY_H
@@ -0,0 +1,147 @@
+//
+// Bounded lock-free ring buffer (Vyukov style) used to hand telemetry and replies between the
+// websocket thread and the planning workers. Any number of producers and consumers may use it.
+// Values are swapped in and out of preallocated slots, so buffers inside them (path vectors,
+// message strings) keep circulating instead of being reallocated for every message.
+//
+
+#ifndef PATH_PLANNING_TELEMETRY_QUEUE_H
+#define PATH_PLANNING_TELEMETRY_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+using namespace std;
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+// Snapshot of a queue's counters, for spotting backpressure
+struct QueueStats {
+    uint64_t pushed;
+    uint64_t popped;
+    uint64_t rejected;  // pushes refused because the queue was full
+    size_t high_water;  // deepest the queue has been
+};
+
+template <typename T, size_t Capacity>
+class TelemetryQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    struct Slot {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    unique_ptr<Slot[]> slots;
+
+    // Padded onto their own cache lines so producers and consumers don't keep stealing them from each other.
+    // (Padding rather than alignas, which new doesn't honour before C++17.)
+    char pad0[CACHE_LINE_SIZE];
+    atomic<size_t> enqueue_pos;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic<size_t>)];
+    atomic<size_t> dequeue_pos;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic<size_t>)];
+
+    atomic<uint64_t> pushed;
+    atomic<uint64_t> popped;
+    atomic<uint64_t> rejected;
+    atomic<size_t> high_water;
+
+    void record_depth(size_t depth) {
+        size_t seen = high_water.load(memory_order_relaxed);
+        while (depth > seen && !high_water.compare_exchange_weak(seen, depth, memory_order_relaxed)) {
+        }
+    }
+
+public:
+    TelemetryQueue() : slots(new Slot[Capacity]), enqueue_pos(0), dequeue_pos(0),
+                       pushed(0), popped(0), rejected(0), high_water(0) {
+        for (size_t i = 0; i < Capacity; i++) {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    TelemetryQueue(const TelemetryQueue &) = delete;
+    TelemetryQueue &operator=(const TelemetryQueue &) = delete;
+
+    // Swap value into the queue, value gets back whatever the slot held before.
+    // Returns false without touching value if the queue is full.
+    bool try_push(T &value) {
+        Slot *slot;
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        for (;;) {
+            slot = &slots[pos & (Capacity - 1)];
+            size_t seq = slot->sequence.load(memory_order_acquire);
+            intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+            if (dif == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                rejected.fetch_add(1, memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueue_pos.load(memory_order_relaxed);
+            }
+        }
+
+        using std::swap;
+        swap(slot->value, value);
+        slot->sequence.store(pos + 1, memory_order_release);
+
+        pushed.fetch_add(1, memory_order_relaxed);
+        // Consumers may have popped past this value already, and a stale read can lag a lap behind,
+        // so the depth is only what lies between the two, at most a full queue
+        size_t dequeued = dequeue_pos.load(memory_order_relaxed);
+        record_depth(dequeued <= pos + 1 ? min(pos + 1 - dequeued, Capacity) : 0);
+        return true;
+    }
+
+    // Swap the oldest value out into value. Returns false if the queue is empty.
+    bool try_pop(T &value) {
+        Slot *slot;
+        size_t pos = dequeue_pos.load(memory_order_relaxed);
+        for (;;) {
+            slot = &slots[pos & (Capacity - 1)];
+            size_t seq = slot->sequence.load(memory_order_acquire);
+            intptr_t dif = (intptr_t) seq - (intptr_t) (pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(memory_order_relaxed);
+            }
+        }
+
+        using std::swap;
+        swap(slot->value, value);
+        slot->sequence.store(pos + Capacity, memory_order_release);
+
+        popped.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+    // Only approximate while other threads are pushing/popping
+    size_t size() const {
+        size_t head = dequeue_pos.load(memory_order_relaxed);
+        size_t tail = enqueue_pos.load(memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    QueueStats stats() const {
+        return {pushed.load(memory_order_relaxed),
+                popped.load(memory_order_relaxed),
+                rejected.load(memory_order_relaxed),
+                high_water.load(memory_order_relaxed)};
+    }
+};
+
+#endif //PATH_PLANNING_TELEMETRY_QUEUE_H
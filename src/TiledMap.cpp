@@ -0,0 +1,490 @@
+//
+// Tile files and the tile cache, see TiledMap.h
+//
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "Frenet.h"
+#include "TiledMap.h"
+
+using namespace std;
+
+bool write_tile_file(const string &map_file, const string &tile_file, int waypoints_per_tile) {
+    // Read the way Map::load_map does, so both end up with exactly the same numbers
+    vector<TileWaypoint> waypoints;
+    ifstream in(map_file.c_str());
+    string line;
+    while (getline(in, line)) {
+        istringstream iss(line);
+        double x;
+        double y;
+        float s;
+        float d_x;
+        float d_y;
+        if (iss >> x >> y >> s >> d_x >> d_y) {
+            waypoints.push_back({x, y, s, d_x, d_y});
+        }
+    }
+    bool usable = waypoints.size() >= 2;
+    for (size_t i = 1; i < waypoints.size() && usable; i++) {
+        usable = waypoints[i].s > waypoints[i - 1].s;
+    }
+    if (!usable) {
+        cerr << "No usable map in " << map_file << ", it needs at least two waypoints with increasing s" << endl;
+        return false;
+    }
+
+    waypoints_per_tile = max(1, waypoints_per_tile);
+    size_t num_waypoints = waypoints.size();
+    size_t num_tiles = (num_waypoints + waypoints_per_tile - 1) / waypoints_per_tile;
+
+    TileFileHeader header;
+    memcpy(header.magic, TILE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TILE_FILE_VERSION;
+    header.byte_order = TILE_BYTE_ORDER_MARK;
+    header.num_waypoints = num_waypoints;
+    header.num_tiles = num_tiles;
+    const TileWaypoint &last = waypoints.back();
+    header.track_length = last.s + sqrt((waypoints[0].x - last.x) * (waypoints[0].x - last.x)
+                                        + (waypoints[0].y - last.y) * (waypoints[0].y - last.y));
+
+    vector<TileIndexEntry> index(num_tiles);
+    uint64_t offset = sizeof(TileFileHeader) + num_tiles * sizeof(TileIndexEntry);
+    for (size_t t = 0; t < num_tiles; t++) {
+        TileIndexEntry &entry = index[t];
+        entry.first_waypoint = t * waypoints_per_tile;
+        entry.count = min((size_t) waypoints_per_tile, num_waypoints - entry.first_waypoint);
+        entry.s_start = waypoints[entry.first_waypoint].s;
+        entry.offset = offset;
+        offset += (entry.count + TILE_OVERLAP) * sizeof(TileWaypoint);
+
+        entry.min_x = entry.max_x = waypoints[entry.first_waypoint].x;
+        entry.min_y = entry.max_y = waypoints[entry.first_waypoint].y;
+        // Up to the next tile's first waypoint, so the box holds the whole of the tile's last segment too
+        for (size_t i = entry.first_waypoint; i <= entry.first_waypoint + entry.count; i++) {
+            const TileWaypoint &wp = waypoints[i % num_waypoints];
+            entry.min_x = min(entry.min_x, wp.x);
+            entry.min_y = min(entry.min_y, wp.y);
+            entry.max_x = max(entry.max_x, wp.x);
+            entry.max_y = max(entry.max_y, wp.y);
+        }
+    }
+
+    ofstream out(tile_file.c_str(), ios::binary | ios::trunc);
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) index.data(), index.size() * sizeof(TileIndexEntry));
+    for (const TileIndexEntry &entry : index) {
+        for (size_t i = 0; i < entry.count + TILE_OVERLAP; i++) {
+            out.write((const char *) &waypoints[(entry.first_waypoint + i) % num_waypoints], sizeof(TileWaypoint));
+        }
+    }
+
+    if (!out) {
+        cerr << "Could not write " << tile_file << endl;
+        return false;
+    }
+    return true;
+}
+
+TiledMap::TiledMap(int num_lanes, double lane_width, size_t cache_size)
+        : num_lanes(num_lanes), lane_width(lane_width), lane_points_total(0), cache_size(max((size_t) 2, cache_size)) {
+    memset(&header, 0, sizeof(header));
+}
+
+TiledMap::~TiledMap() {
+    close_file();
+}
+
+void TiledMap::close_file() {
+    if (data) {
+        munmap((void *) data, data_size);
+        data = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool TiledMap::open(const string &tile_file) {
+    // Held across the unmap and remap, so a tile being decoded on another thread never reads unmapped memory
+    lock_guard<mutex> lock(cache_mutex);
+    close_file();
+    cache.clear();
+    lru.clear();
+
+    fd = ::open(tile_file.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        cerr << "Could not open tile file " << tile_file << endl;
+        close_file();
+        return false;
+    }
+    data_size = info.st_size;
+
+    void *mapped = data_size > 0 ? mmap(nullptr, data_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (mapped == MAP_FAILED) {
+        cerr << "Could not map tile file " << tile_file << endl;
+        close_file();
+        return false;
+    }
+    data = (const unsigned char *) mapped;
+
+    const char *problem = nullptr;
+    if (data_size < sizeof(TileFileHeader)) {
+        problem = "too short";
+    } else {
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, TILE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+            problem = "not a tile file";
+        } else if (header.version != TILE_FILE_VERSION || header.byte_order != TILE_BYTE_ORDER_MARK) {
+            problem = "written by another version or on a machine with another byte order";
+        } else if (header.num_tiles == 0 || header.num_waypoints < 2 || !(header.track_length > 0)
+                   || data_size < sizeof(TileFileHeader) + (size_t) header.num_tiles * sizeof(TileIndexEntry)) {
+            problem = "bad header";
+        }
+    }
+
+    if (!problem) {
+        index.resize(header.num_tiles);
+        memcpy(index.data(), data + sizeof(TileFileHeader), index.size() * sizeof(TileIndexEntry));
+
+        // Check every tile once here, so decoding never has to, and the index can be binary searched by s
+        uint32_t next_waypoint = 0;
+        double previous_s = -1;
+        for (const TileIndexEntry &entry : index) {
+            if (entry.first_waypoint != next_waypoint || entry.count == 0
+                || entry.offset + (entry.count + TILE_OVERLAP) * sizeof(TileWaypoint) > data_size) {
+                problem = "bad tile index";
+                break;
+            }
+            if (!(entry.s_start > previous_s && entry.s_start < header.track_length)) {
+                problem = "tile s doesn't increase along the track";
+                break;
+            }
+            next_waypoint += entry.count;
+            previous_s = entry.s_start;
+        }
+        if (!problem && next_waypoint != header.num_waypoints) {
+            problem = "tiles don't add up to the waypoints";
+        }
+    }
+
+    if (problem) {
+        cerr << "Bad tile file " << tile_file << ": " << problem << endl;
+        close_file();
+        index.clear();
+        memset(&header, 0, sizeof(header));
+        return false;
+    }
+
+    tile_s_starts.clear();
+    for (const TileIndexEntry &entry : index) {
+        tile_s_starts.push_back(entry.s_start);
+    }
+    lane_points_total = (int) ceil(header.track_length / LANE_POLYLINE_STEP);
+    stats = TileCacheStats();
+
+    return true;
+}
+
+// The lane point the tile starts at, so every point belongs to exactly one tile
+static int first_lane_point(const TileIndexEntry &entry, int tile) {
+    return tile == 0 ? 0 : (int) ceil(entry.s_start / LANE_POLYLINE_STEP);
+}
+
+shared_ptr<const TiledMap::Tile> TiledMap::decode(int t) const {
+    const TileIndexEntry &entry = index[t];
+
+    shared_ptr<Tile> tile = make_shared<Tile>();
+    tile->index = t;
+    tile->first_waypoint = entry.first_waypoint;
+    tile->waypoints.resize(entry.count + TILE_OVERLAP);
+    memcpy(tile->waypoints.data(), data + entry.offset, tile->waypoints.size() * sizeof(TileWaypoint));
+    tile->s_end = t + 1 < (int) index.size() ? index[t + 1].s_start : header.track_length;
+
+    // Lane points like Map::build_lane_polylines, sweeping over the tile's segments, plus the next tile's first
+    tile->first_lane_point = first_lane_point(entry, t);
+    int end = t + 1 < (int) index.size() ? first_lane_point(index[t + 1], t + 1) : lane_points_total;
+    tile->lane_points_x.assign(num_lanes, vector<double>());
+    tile->lane_points_y.assign(num_lanes, vector<double>());
+
+    // The last tile's overlap wraps around to s = 0, only the others may sweep on into the next tile
+    int local_wp = 0;
+    int last_local = t + 1 < (int) index.size() ? entry.count + TILE_OVERLAP - 2 : entry.count - 1;
+    for (int k = tile->first_lane_point; k <= end; k++) {
+        double s = k * LANE_POLYLINE_STEP;
+        int wp = local_wp;
+        if (k == lane_points_total) {
+            // Closing the loop, the point after the last is the one at s = 0 on the first waypoint's segment
+            s = 0;
+            wp = entry.count;
+        } else {
+            while (local_wp < last_local && s > tile->waypoints[local_wp + 1].s
+                   && tile->waypoints[local_wp + 1].s > tile->waypoints[local_wp].s) {
+                local_wp++;
+            }
+            wp = local_wp;
+        }
+
+        for (int lane = 0; lane < num_lanes; lane++) {
+            pair<double, double> xy = segmentXY(*tile, wp, s, lane_center(lane));
+            tile->lane_points_x[lane].push_back(xy.first);
+            tile->lane_points_y[lane].push_back(xy.second);
+        }
+    }
+
+    return tile;
+}
+
+shared_ptr<const TiledMap::Tile> TiledMap::get_tile(int t) const {
+    lock_guard<mutex> lock(cache_mutex);
+
+    auto found = cache.find(t);
+    if (found != cache.end()) {
+        stats.hits++;
+        lru.splice(lru.begin(), lru, found->second.second);
+        return found->second.first;
+    }
+
+    // Decoding a tile is a copy and a few hundred lane points, quick enough to do under the lock
+    shared_ptr<const Tile> tile = decode(t);
+    stats.loads++;
+    lru.push_front(t);
+    cache[t] = make_pair(tile, lru.begin());
+
+    if (cache.size() > cache_size) {
+        cache.erase(lru.back());
+        lru.pop_back();
+        stats.evictions++;
+    }
+
+    return tile;
+}
+
+void TiledMap::prefetch(double s, double distance) const {
+    if (index.empty()) {
+        return;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    int first = tile_for_s(wrap_s(s, header.track_length));
+    // Never more tiles than fit in the cache, or prefetching would evict what it just loaded
+    for (size_t n = 0, t = first; n < cache_size - 1; n++, t = (t + 1) % index.size()) {
+        const TileIndexEntry &entry = index[t];
+
+        // Have the OS read the tile's pages in the background before we decode it
+        uintptr_t start = (uintptr_t) (data + entry.offset) & ~(uintptr_t) (page - 1);
+        uintptr_t end = (uintptr_t) (data + entry.offset + (entry.count + TILE_OVERLAP) * sizeof(TileWaypoint));
+        madvise((void *) start, end - start, MADV_WILLNEED);
+
+        get_tile(t);
+
+        double tile_end = t + 1 < index.size() ? index[t + 1].s_start : header.track_length;
+        if (s_diff(tile_end, s, header.track_length) >= distance || n + 1 == index.size()) {
+            break;
+        }
+    }
+}
+
+int TiledMap::tile_for_s(double s) const {
+    int t = (int) (lower_bound(tile_s_starts.begin(), tile_s_starts.end(), s) - tile_s_starts.begin()) - 1;
+    return max(t, 0);
+}
+
+int TiledMap::WaypointSegment(double s) const {
+    s = wrap_s(s, header.track_length);
+    shared_ptr<const Tile> tile = get_tile(tile_for_s(s));
+
+    auto begin = tile->waypoints.begin();
+    auto end = begin + (tile->waypoints.size() - TILE_OVERLAP);
+    int local_wp = (int) (lower_bound(begin, end, s, [](const TileWaypoint &wp, double s) {
+        return wp.s < s;
+    }) - begin) - 1;
+
+    return tile->first_waypoint + max(local_wp, 0);
+}
+
+pair<double, double> TiledMap::segmentXY(const Tile &tile, int local_wp, double s, double d) const {
+    const TileWaypoint &wp = tile.waypoints[local_wp];
+    const TileWaypoint &wp2 = tile.waypoints[local_wp + 1];
+
+    double heading = atan2(wp2.y - wp.y, wp2.x - wp.x);
+    double seg_s = s - wp.s;
+
+    double seg_x = wp.x + seg_s * cos(heading);
+    double seg_y = wp.y + seg_s * sin(heading);
+
+    double perp_heading = heading - M_PI / 2;
+
+    return make_pair(seg_x + d * cos(perp_heading), seg_y + d * sin(perp_heading));
+}
+
+pair<double, double> TiledMap::getXY(double s, double d) const {
+    s = wrap_s(s, header.track_length);
+    int wp = WaypointSegment(s);
+    shared_ptr<const Tile> tile = get_tile(tile_for_s(s));
+    return segmentXY(*tile, wp - tile->first_waypoint, s, d);
+}
+
+pair<double, double> TiledMap::getLaneXY(double s, int lane) const {
+    s = wrap_s(s, header.track_length);
+
+    int i = min((int) (s / LANE_POLYLINE_STEP), lane_points_total - 1);
+
+    // Last tile whose first lane point is at or before i
+    int t = tile_for_s(i * LANE_POLYLINE_STEP);
+    while (t + 1 < (int) index.size() && first_lane_point(index[t + 1], t + 1) <= i) {
+        t++;
+    }
+    while (t > 0 && first_lane_point(index[t], t) > i) {
+        t--;
+    }
+    shared_ptr<const Tile> tile = get_tile(t);
+
+    const vector<double> &xs = tile->lane_points_x[lane];
+    const vector<double> &ys = tile->lane_points_y[lane];
+    int local = i - tile->first_lane_point;
+
+    // Last step closes the loop, so it's usually shorter than LANE_POLYLINE_STEP
+    double seg_start = i * LANE_POLYLINE_STEP;
+    double seg_length = i + 1 == lane_points_total ? header.track_length - seg_start : LANE_POLYLINE_STEP;
+    double u = (s - seg_start) / seg_length;
+
+    return make_pair(xs[local] + u * (xs[local + 1] - xs[local]), ys[local] + u * (ys[local + 1] - ys[local]));
+}
+
+// Keep the k nearest tiles seen so far in near, sorted by distance, count of them in use
+static void insert_candidate(pair<double, int> *near, int &count, int k, double dist2, int tile) {
+    if (count == k && dist2 >= near[k - 1].first) {
+        return;
+    }
+    int i = count < k ? count++ : k - 1;
+    for (; i > 0 && near[i - 1].first > dist2; i--) {
+        near[i] = near[i - 1];
+    }
+    near[i] = make_pair(dist2, tile);
+}
+
+void TiledMap::closest_in_tile(int t, double x, double y, Closest &closest) const {
+    shared_ptr<const Tile> tile = get_tile(t);
+    for (size_t i = 0; i + TILE_OVERLAP < tile->waypoints.size(); i++) {
+        const TileWaypoint &wp = tile->waypoints[i];
+        const TileWaypoint &next = tile->waypoints[i + 1];
+        SegmentProjection projection = project_onto_segment(wp.x, wp.y, next.x, next.y, x, y);
+        int global = tile->first_waypoint + i;
+        // Ties go to the lower waypoint, so the answer doesn't depend on the order tiles are visited in
+        if (projection.dist2 < closest.dist2 || (projection.dist2 == closest.dist2 && global < closest.waypoint)) {
+            closest.dist2 = projection.dist2;
+            closest.waypoint = global;
+            closest.projection = projection;
+            closest.s = wp.s;
+            closest.tile = t;
+        }
+    }
+}
+
+// Squared distance from (x, y) to a tile's bounding box, nothing in the tile can be closer
+static double box_dist2(const TileIndexEntry &entry, double x, double y) {
+    double out_x = max(max(entry.min_x - x, x - entry.max_x), 0.);
+    double out_y = max(max(entry.min_y - y, y - entry.max_y), 0.);
+    return out_x * out_x + out_y * out_y;
+}
+
+TiledMap::Closest TiledMap::closest_anywhere(double x, double y) const {
+
+    // The few nearest tiles, without allocating or sorting the whole index
+    pair<double, int> near[TILE_FRENET_CANDIDATES];
+    int count = 0;
+    for (int t = 0; t < (int) index.size(); t++) {
+        insert_candidate(near, count, TILE_FRENET_CANDIDATES, box_dist2(index[t], x, y), t);
+    }
+
+    Closest closest;
+    for (int i = 0; i < count && near[i].first <= closest.dist2; i++) {
+        closest_in_tile(near[i].second, x, y, closest);
+    }
+
+    // Rarely, e.g. far off the road, even the furthest of those could still hold something closer, and so
+    // could tiles that didn't make the list: look at every one of those
+    if (count == TILE_FRENET_CANDIDATES && near[count - 1].first <= closest.dist2) {
+        for (int t = 0; t < (int) index.size(); t++) {
+            bool visited = false;
+            for (int i = 0; i < count && !visited; i++) {
+                visited = near[i].second == t;
+            }
+            if (!visited && box_dist2(index[t], x, y) <= closest.dist2) {
+                closest_in_tile(t, x, y, closest);
+            }
+        }
+    }
+
+    return closest;
+}
+
+pair<double, double> TiledMap::closestFrenet(const Closest &closest) const {
+    // From here on the same as Map::getFrenet
+    double frenet_s = projection_s(closest.projection, closest.s);
+    return make_pair(wrap_s(frenet_s, header.track_length), projection_d(closest.projection));
+}
+
+pair<double, double> TiledMap::getFrenet(double x, double y, double theta) const {
+    if (index.empty()) {
+        return make_pair(0., 0.); // nothing opened, there's no road to be on
+    }
+    return closestFrenet(closest_anywhere(x, y));
+}
+
+pair<double, double> TiledMap::getFrenet(double x, double y, double theta, double s_hint) const {
+    if (index.empty()) {
+        return make_pair(0., 0.);
+    }
+    int tile = tile_for_s(wrap_s(s_hint, header.track_length));
+    return getFrenetNear(tile, x, y);
+}
+
+pair<double, double> TiledMap::getFrenetNear(int &tile, double x, double y) const {
+    if (index.empty()) {
+        return make_pair(0., 0.);
+    }
+
+    int num_tiles = index.size();
+    Closest closest;
+    bool settled = false;
+    if (tile >= 0 && tile < num_tiles) {
+        // Walk to whichever neighboring tile holds a closer segment until neither does, like
+        // Map::LocalClosestSegment does segment by segment
+        closest_in_tile(tile, x, y, closest);
+        for (int steps = 0; steps < TILE_FRENET_LOCAL_STEPS && !settled; steps++) {
+            int center = closest.tile;
+            for (int neighbor : {center == 0 ? num_tiles - 1 : center - 1, center + 1 == num_tiles ? 0 : center + 1}) {
+                if (box_dist2(index[neighbor], x, y) <= closest.dist2) {
+                    closest_in_tile(neighbor, x, y, closest);
+                }
+            }
+            settled = closest.tile == center;
+        }
+    }
+
+    // Teleported, or found a different stretch of road that just happens to be nearby
+    if (!settled || closest.dist2 > FRENET_LOCAL_SEARCH_DISTANCE * FRENET_LOCAL_SEARCH_DISTANCE) {
+        closest = closest_anywhere(x, y);
+    }
+
+    tile = closest.tile;
+    return closestFrenet(closest);
+}
+
+TileCacheStats TiledMap::cache_stats() const {
+    lock_guard<mutex> lock(cache_mutex);
+    TileCacheStats current = stats;
+    current.cached = cache.size();
+    return current;
+}
@@ -0,0 +1,192 @@
+//
+// Waypoint map for road networks too big to hold in memory. The waypoints live in a tile file (written by
+// map_tiler from the usual CSV) that is memory-mapped, and only the tiles around the car are decoded, along
+// with their lane polylines, into a small LRU cache. Memory stays bounded by the cache size however long
+// the road is; the file itself is only paged in by the OS as tiles are read.
+//
+// Answers the same queries as Map, which still holds the simulator's highway in memory, but isn't a drop-in
+// for it: the planner keeps per-car map segment indices (getFrenetStates) that TiledMap doesn't offer, and a
+// common virtual interface would cost a call per conversion on a road that fits in memory anyway. So nothing
+// drives on a TiledMap yet; map_tiler --check is what keeps the two giving the same answers, driving around
+// the loop with prefetching and warm-started Frenet conversions, until a road needs it.
+//
+// Tile file layout, native byte order (checked when opened):
+//
+//   TileFileHeader | num_tiles * TileIndexEntry | per tile: (count + TILE_OVERLAP) * TileWaypoint
+//
+// Each tile repeats the first TILE_OVERLAP waypoints after it (wrapping at the end of the loop), so anything
+// inside a tile can be answered without touching the next one.
+//
+
+#ifndef PATH_PLANNING_TILED_MAP_H
+#define PATH_PLANNING_TILED_MAP_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Map.h"
+
+using namespace std;
+
+static const char TILE_FILE_MAGIC[8] = {'P', 'P', 'T', 'I', 'L', 'E', 'S', 0};
+static const uint32_t TILE_FILE_VERSION = 2; // 2: boxes include the segment into the next tile
+static const uint32_t TILE_BYTE_ORDER_MARK = 0x01020304;
+static const int TILE_OVERLAP = 2;
+static const int DEFAULT_WAYPOINTS_PER_TILE = 16;
+static const int DEFAULT_TILE_CACHE_SIZE = 8;
+// Nearest tiles getFrenet looks through first, enough for any position near the road
+static const int TILE_FRENET_CANDIDATES = 4;
+// Tiles getFrenetNear walks from its starting one before giving up and looking through the whole index
+static const int TILE_FRENET_LOCAL_STEPS = 4;
+
+struct TileFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t num_waypoints;
+    uint32_t num_tiles;
+    double track_length;
+};
+
+struct TileIndexEntry {
+    double s_start; // s of the tile's first waypoint
+    double min_x;   // bounding box of its segments, for finding tiles near a position
+    double min_y;
+    double max_x;
+    double max_y;
+    uint64_t offset; // of its first TileWaypoint in the file
+    uint32_t first_waypoint;
+    uint32_t count;  // waypoints in the tile, not counting the overlap
+};
+
+struct TileWaypoint {
+    double x;
+    double y;
+    double s;
+    double dx;
+    double dy;
+};
+
+// Convert a CSV waypoint map (the format Map::load_map reads) to a tile file, false if either can't be done
+bool write_tile_file(const string &map_file, const string &tile_file, int waypoints_per_tile);
+
+struct TileCacheStats {
+    uint64_t hits = 0;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+    size_t cached = 0;
+};
+
+class TiledMap {
+
+public:
+    // A decoded tile, kept alive by whoever still holds it even after it's evicted from the cache
+    struct Tile {
+        int index;
+        int first_waypoint;
+        vector<TileWaypoint> waypoints; // count + TILE_OVERLAP
+        double s_end;                   // where the next tile starts, track_length for the last one
+
+        // Lane-center points at s = (first_lane_point + i) * LANE_POLYLINE_STEP, one past the tile's end included
+        int first_lane_point;
+        vector<vector<double>> lane_points_x;
+        vector<vector<double>> lane_points_y;
+    };
+
+private:
+    int fd = -1;
+    const unsigned char *data = nullptr;
+    size_t data_size = 0;
+
+    TileFileHeader header;
+    vector<TileIndexEntry> index; // small: one entry per tile, so it stays in memory
+    vector<double> tile_s_starts;
+
+    int num_lanes;
+    double lane_width;
+    int lane_points_total; // over the whole loop, the same as Map's
+
+    size_t cache_size;
+    mutable mutex cache_mutex;
+    mutable list<int> lru; // most recently used first
+    mutable unordered_map<int, pair<shared_ptr<const Tile>, list<int>::iterator>> cache;
+    mutable TileCacheStats stats;
+
+    shared_ptr<const Tile> decode(int tile) const;
+
+    // Tile holding the map segment s falls in, same boundaries as Map::WaypointSegment
+    int tile_for_s(double s) const;
+
+    pair<double, double> segmentXY(const Tile &tile, int local_wp, double s, double d) const;
+
+    // Closest map segment to a position found so far
+    struct Closest {
+        double dist2 = 1e300;
+        int waypoint = 0;
+        SegmentProjection projection = SegmentProjection();
+        double s = 0; // of the segment's first waypoint
+        int tile = 0;
+    };
+
+    // Update closest with the tile's segments
+    void closest_in_tile(int tile, double x, double y, Closest &closest) const;
+
+    // Closest segment on the whole map, looking at the tiles with the nearest bounding boxes first
+    Closest closest_anywhere(double x, double y) const;
+
+    pair<double, double> closestFrenet(const Closest &closest) const;
+
+    void close_file();
+
+public:
+    TiledMap(int num_lanes = NUM_LANES, double lane_width = LANE_WIDTH, size_t cache_size = DEFAULT_TILE_CACHE_SIZE);
+    ~TiledMap();
+
+    TiledMap(const TiledMap &) = delete;
+    TiledMap &operator=(const TiledMap &) = delete;
+
+    // Map the tile file and read its index, false (and a message on cerr) if it isn't a usable tile file.
+    // Tiles already handed out stay valid, and tile loads on other threads wait for it, but the index it
+    // rebuilds isn't locked: don't query a TiledMap while reopening it, swap in a new one like MapStore does.
+    bool open(const string &tile_file);
+
+    // Tile from the cache, decoding it (and maybe evicting the least recently used one) if needed
+    shared_ptr<const Tile> get_tile(int tile) const;
+
+    // Get the tiles covering [s, s + distance) ready ahead of the car, so queries along the route don't stall
+    void prefetch(double s, double distance) const;
+
+    int WaypointSegment(double s) const;
+
+    // Transform from Cartesian x,y to Frenet s,d like Map::getFrenet. Goes over the whole (in memory) index
+    // to find the nearest tiles, so prefer the warm-started versions below for anything moving along the road.
+    pair<double, double> getFrenet(double x, double y, double theta) const;
+
+    // Same, starting the search from the tile s_hint falls in, a binary search of the index
+    pair<double, double> getFrenet(double x, double y, double theta, double s_hint) const;
+
+    // Same, starting from the tile in tile and updating it to the one (x, y) projects onto, like
+    // Map::getFrenetNear. Only the tiles around it are looked at, unless (x, y) turns out to be far from
+    // there or tile is -1 or not one of this map's, then the whole index is.
+    pair<double, double> getFrenetNear(int &tile, double x, double y) const;
+
+    pair<double, double> getXY(double s, double d) const;
+
+    pair<double, double> getLaneXY(double s, int lane) const;
+
+    double get_track_length() const { return header.track_length; }
+    int num_waypoints() const { return header.num_waypoints; }
+    int num_tiles() const { return header.num_tiles; }
+    int get_num_lanes() const { return num_lanes; }
+    double get_lane_width() const { return lane_width; }
+    double lane_center(int lane) const { return lane_width * (lane + .5); }
+
+    TileCacheStats cache_stats() const;
+};
+
+#endif //PATH_PLANNING_TILED_MAP_H
@@ -2,12 +2,22 @@
 // Created by Mark on 2/9/18.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <ios>
+#include "Frenet.h"
 #include "Map.h"
 
 using namespace std;
 
-void Map::load_map(string map_file) {
+static atomic<uint64_t> last_generation(0);
+
+bool Map::load_map(string map_file, int num_lanes, double lane_width) {
+    generation = ++last_generation;
+    this->num_lanes = num_lanes;
+    this->lane_width = lane_width;
+
     map_waypoints_x.clear();
     map_waypoints_y.clear();
     map_waypoints_s.clear();
@@ -24,29 +34,141 @@ void Map::load_map(string map_file) {
         float s;
         float d_x;
         float d_y;
-        iss >> x;
-        iss >> y;
-        iss >> s;
-        iss >> d_x;
-        iss >> d_y;
+        // Blank or broken lines would otherwise add a waypoint of whatever was on the stack
+        if (!(iss >> x >> y >> s >> d_x >> d_y)) {
+            continue;
+        }
         map_waypoints_x.push_back(x);
         map_waypoints_y.push_back(y);
         map_waypoints_s.push_back(s);
         map_waypoints_dx.push_back(d_x);
         map_waypoints_dy.push_back(d_y);
     }
+
+    // WaypointSegment's binary search needs s going up along the loop, and a loop needs two waypoints
+    bool usable = map_waypoints_s.size() >= 2;
+    for (size_t i = 1; i < map_waypoints_s.size() && usable; i++) {
+        usable = map_waypoints_s[i] > map_waypoints_s[i - 1];
+    }
+    if (!usable) {
+        cerr << "No usable map in " << map_file << ", it needs at least two waypoints with increasing s" << endl;
+        map_waypoints_x.clear();
+        map_waypoints_y.clear();
+        map_waypoints_s.clear();
+        map_waypoints_dx.clear();
+        map_waypoints_dy.clear();
+    }
+
+    if (!map_waypoints_s.empty()) {
+        int last = map_waypoints_s.size() - 1;
+        track_length = map_waypoints_s[last] + distance(map_waypoints_x[last], map_waypoints_y[last],
+                                                        map_waypoints_x[0], map_waypoints_y[0]);
+    }
+
+    // For ClosestSegment, 0 for a repeated waypoint so it just measures the distance to it
+    int num_wps = map_waypoints_x.size();
+    segment_inv_length2.resize(num_wps);
+    for (int i = 0; i < num_wps; i++) {
+        int next = i + 1 == num_wps ? 0 : i + 1;
+        double n_x = map_waypoints_x[next] - map_waypoints_x[i];
+        double n_y = map_waypoints_y[next] - map_waypoints_y[i];
+        double length2 = n_x * n_x + n_y * n_y;
+        segment_inv_length2[i] = length2 > 0 ? 1 / length2 : 0;
+    }
+
+    build_segment_grid();
+    build_lane_polylines();
+    return usable;
+}
+
+void Map::build_segment_grid() {
+    int num_wps = map_waypoints_x.size();
+    grid_cols = 0;
+    grid_rows = 0;
+    grid_cell_start.clear();
+    grid_segments.clear();
+    if (num_wps == 0) {
+        return;
+    }
+
+    grid_min_x = *min_element(map_waypoints_x.begin(), map_waypoints_x.end());
+    grid_min_y = *min_element(map_waypoints_y.begin(), map_waypoints_y.end());
+    double max_x = *max_element(map_waypoints_x.begin(), map_waypoints_x.end());
+    double max_y = *max_element(map_waypoints_y.begin(), map_waypoints_y.end());
+    grid_cols = (int) floor((max_x - grid_min_x) / SEGMENT_GRID_CELL) + 1;
+    grid_rows = (int) floor((max_y - grid_min_y) / SEGMENT_GRID_CELL) + 1;
+
+    // Every segment goes in all the cells its bounding box touches, counted first and then filled in
+    auto for_each_cell = [&](int segment, function<void(int)> f) {
+        int next = segment + 1 == num_wps ? 0 : segment + 1;
+        int col0 = (int) floor((min(map_waypoints_x[segment], map_waypoints_x[next]) - grid_min_x) / SEGMENT_GRID_CELL);
+        int col1 = (int) floor((max(map_waypoints_x[segment], map_waypoints_x[next]) - grid_min_x) / SEGMENT_GRID_CELL);
+        int row0 = (int) floor((min(map_waypoints_y[segment], map_waypoints_y[next]) - grid_min_y) / SEGMENT_GRID_CELL);
+        int row1 = (int) floor((max(map_waypoints_y[segment], map_waypoints_y[next]) - grid_min_y) / SEGMENT_GRID_CELL);
+        for (int r = row0; r <= row1; r++) {
+            for (int c = col0; c <= col1; c++) {
+                f(r * grid_cols + c);
+            }
+        }
+    };
+
+    grid_cell_start.assign(grid_cols * grid_rows + 1, 0);
+    for (int i = 0; i < num_wps; i++) {
+        for_each_cell(i, [&](int cell) { grid_cell_start[cell + 1]++; });
+    }
+    for (int cell = 0; cell < grid_cols * grid_rows; cell++) {
+        grid_cell_start[cell + 1] += grid_cell_start[cell];
+    }
+    grid_segments.resize(grid_cell_start.back());
+    vector<int> filled(grid_cell_start.begin(), grid_cell_start.end() - 1);
+    for (int i = 0; i < num_wps; i++) {
+        for_each_cell(i, [&](int cell) { grid_segments[filled[cell]++] = i; });
+    }
+}
+
+void Map::build_lane_polylines() {
+    int num_points = (int) ceil(track_length / LANE_POLYLINE_STEP);
+
+    lane_points_x.resize(num_lanes);
+    lane_points_y.resize(num_lanes);
+    for (int lane = 0; lane < num_lanes; lane++) {
+        lane_points_x[lane].clear();
+        lane_points_y[lane].clear();
+        lane_points_x[lane].reserve(num_points);
+        lane_points_y[lane].reserve(num_points);
+    }
+
+    if (map_waypoints_s.empty()) {
+        return;
+    }
+
+    // One sweep along the road, advancing the waypoint segment as we go rather than searching for every point
+    int prev_wp = 0;
+    int last_wp = map_waypoints_s.size() - 1;
+    for (int i = 0; i < num_points; i++) {
+        double s = i * LANE_POLYLINE_STEP;
+        while (prev_wp < last_wp && s > map_waypoints_s[prev_wp + 1]) {
+            prev_wp++;
+        }
+
+        for (int lane = 0; lane < num_lanes; lane++) {
+            pair<double, double> xy = segmentXY(prev_wp, s, lane_center(lane));
+            lane_points_x[lane].push_back(xy.first);
+            lane_points_y[lane].push_back(xy.second);
+        }
+    }
 }
 
 // Now, if we swap in a different type of map, can use different distance measurements.
-double Map::distance(double x1, double y1, double x2, double y2) {
+double Map::distance(double x1, double y1, double x2, double y2) const {
     return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
 }
 
-int Map::ClosestWaypoint(double x, double y) {
+int Map::ClosestWaypoint(double x, double y) const {
     double closestLen = 100000; //large number
     int closestWaypoint = 0;
 
-    for (int i = 0; i < map_waypoints_x.size(); i++) {
+    for (int i = 0; i < (int) map_waypoints_x.size(); i++) {
         double map_x = map_waypoints_x[i];
         double map_y = map_waypoints_y[i];
         double dist = distance(x, y, map_x, map_y);
@@ -60,7 +182,7 @@ int Map::ClosestWaypoint(double x, double y) {
 
 }
 
-int Map::NextWaypoint(double x, double y, double theta) {
+int Map::NextWaypoint(double x, double y, double theta) const {
     int closestWaypoint = ClosestWaypoint(x, y);
 
     double map_x = map_waypoints_x[closestWaypoint];
@@ -73,7 +195,7 @@ int Map::NextWaypoint(double x, double y, double theta) {
 
     if (angle > M_PI / 4) {
         closestWaypoint++;
-        if (closestWaypoint == map_waypoints_x.size()) {
+        if (closestWaypoint == (int) map_waypoints_x.size()) {
             closestWaypoint = 0;
         }
     }
@@ -81,59 +203,198 @@ int Map::NextWaypoint(double x, double y, double theta) {
     return closestWaypoint;
 }
 
-// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
-pair<double, double> Map::getFrenet(double x, double y, double theta) {
-    int next_wp = NextWaypoint(x, y, theta);
+SegmentProjection Map::projectOntoSegment(int prev_wp, double x, double y) const {
+    int next_wp = prev_wp + 1 == (int) map_waypoints_x.size() ? 0 : prev_wp + 1;
+    return project_onto_segment(map_waypoints_x[prev_wp], map_waypoints_y[prev_wp],
+                                map_waypoints_x[next_wp], map_waypoints_y[next_wp], x, y);
+}
 
-    int prev_wp;
-    prev_wp = next_wp - 1;
-    if (next_wp == 0) {
-        prev_wp = map_waypoints_x.size() - 1;
+int Map::ClosestSegment(double x, double y) const {
+    int col = (int) floor((x - grid_min_x) / SEGMENT_GRID_CELL);
+    int row = (int) floor((y - grid_min_y) / SEGMENT_GRID_CELL);
+    if (col < 0 || col >= grid_cols || row < 0 || row >= grid_rows) {
+        return ClosestSegmentSweep(x, y);
     }
 
-    double n_x = map_waypoints_x[next_wp] - map_waypoints_x[prev_wp];
-    double n_y = map_waypoints_y[next_wp] - map_waypoints_y[prev_wp];
-    double x_x = x - map_waypoints_x[prev_wp];
-    double x_y = y - map_waypoints_y[prev_wp];
-
-    // find the projection of x onto n
-    double proj_norm = (x_x * n_x + x_y * n_y) / (n_x * n_x + n_y * n_y);
-    double proj_x = proj_norm * n_x;
-    double proj_y = proj_norm * n_y;
+    // Rings of cells around (x, y), until nothing further out can be closer than what's been found
+    double closest_dist = 1e300;
+    int closest = -1;
+    int max_ring = max(grid_cols, grid_rows);
+    for (int ring = 0; ring <= max_ring; ring++) {
+        for (int r = max(row - ring, 0); r <= min(row + ring, grid_rows - 1); r++) {
+            bool edge_row = r == row - ring || r == row + ring;
+            for (int c = max(col - ring, 0); c <= min(col + ring, grid_cols - 1); c++) {
+                if (!edge_row && c != col - ring && c != col + ring) {
+                    c = col + ring - 1; // only the ring's outline, skip over its inside
+                    continue;
+                }
+                int cell = r * grid_cols + c;
+                for (int k = grid_cell_start[cell]; k < grid_cell_start[cell + 1]; k++) {
+                    int segment = grid_segments[k];
+                    double dist = projectOntoSegment(segment, x, y).dist2;
+                    // Lowest index on a tie, like the sweep
+                    if (dist < closest_dist || (dist == closest_dist && segment < closest)) {
+                        closest_dist = dist;
+                        closest = segment;
+                    }
+                }
+            }
+        }
 
-    double frenet_d = distance(x_x, x_y, proj_x, proj_y);
+        // Everything not looked at yet is at least ring cells away
+        double reach = ring * SEGMENT_GRID_CELL;
+        if (closest >= 0 && closest_dist <= reach * reach) {
+            break;
+        }
+    }
 
-    //see if d value is positive or negative by comparing it to a center point
+    return closest >= 0 ? closest : ClosestSegmentSweep(x, y);
+}
 
-    double center_x = 1000 - map_waypoints_x[prev_wp];
-    double center_y = 2000 - map_waypoints_y[prev_wp];
-    double centerToPos = distance(center_x, center_y, x_x, x_y);
-    double centerToRef = distance(center_x, center_y, proj_x, proj_y);
+int Map::ClosestSegmentSweep(double x, double y) const {
+    int num_wps = map_waypoints_x.size();
+    const double *xs = map_waypoints_x.data();
+    const double *ys = map_waypoints_y.data();
+    const double *inv_length2 = segment_inv_length2.data();
+
+    // The same as projectOntoSegment, but without the division or wrapping around for the next waypoint,
+    // the segment closing the loop is done on its own afterwards
+    double closest_dist = 1e300;
+    int closest = 0;
+    for (int i = 0; i + 1 < num_wps; i++) {
+        double n_x = xs[i + 1] - xs[i];
+        double n_y = ys[i + 1] - ys[i];
+        double x_x = x - xs[i];
+        double x_y = y - ys[i];
+
+        double t = min(max((x_x * n_x + x_y * n_y) * inv_length2[i], 0.), 1.);
+        double e_x = x_x - t * n_x;
+        double e_y = x_y - t * n_y;
+        double dist = e_x * e_x + e_y * e_y;
+        if (dist < closest_dist) {
+            closest_dist = dist;
+            closest = i;
+        }
+    }
 
-    if (centerToPos <= centerToRef) {
-        frenet_d *= -1;
+    if (num_wps > 0 && projectOntoSegment(num_wps - 1, x, y).dist2 < closest_dist) {
+        closest = num_wps - 1;
     }
 
-    // calculate s value
-    double frenet_s = 0;
-    for (int i = 0; i < prev_wp; i++) {
-        frenet_s += distance(map_waypoints_x[i], map_waypoints_y[i],
-                               map_waypoints_x[i + 1], map_waypoints_y[i + 1]);
+    return closest;
+}
+
+int Map::LocalClosestSegment(int start, double x, double y, int max_steps) const {
+    int num_wps = map_waypoints_x.size();
+    int closest = start;
+    double closest_dist = projectOntoSegment(start, x, y).dist2;
+
+    // Distance to the road only has one minimum nearby, so go downhill until it stops getting closer
+    for (int steps = 0; steps < num_wps; steps++) {
+        int prev = closest == 0 ? num_wps - 1 : closest - 1;
+        int next = closest + 1 == num_wps ? 0 : closest + 1;
+        double prev_dist = projectOntoSegment(prev, x, y).dist2;
+        double next_dist = projectOntoSegment(next, x, y).dist2;
+
+        if (steps == max_steps && (prev_dist < closest_dist || next_dist < closest_dist)) {
+            return -1;
+        }
+        if (prev_dist < closest_dist && prev_dist <= next_dist) {
+            closest = prev;
+            closest_dist = prev_dist;
+        } else if (next_dist < closest_dist) {
+            closest = next;
+            closest_dist = next_dist;
+        } else {
+            break;
+        }
     }
 
-    frenet_s += distance(0, 0, proj_x, proj_y);
+    return closest;
+}
 
-    return make_pair(frenet_s, frenet_d);
+pair<double, double> Map::segmentFrenet(int prev_wp, double x, double y) const {
+    SegmentProjection projection = projectOntoSegment(prev_wp, x, y);
+    double frenet_s = projection_s(projection, map_waypoints_s[prev_wp]);
+    return make_pair(wrap_s(frenet_s, track_length), projection_d(projection));
 }
 
-// Transform from Frenet s,d coordinates to Cartesian x,y
-pair<double, double> Map::getXY(double s, double d) {
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+pair<double, double> Map::getFrenet(double x, double y, double theta) const {
+    return segmentFrenet(ClosestSegment(x, y), x, y);
+}
+
+pair<double, double> Map::getFrenet(double x, double y, double theta, double s_hint) const {
+    int segment = WaypointSegment(s_hint);
+    return getFrenetNear(segment, x, y);
+}
+
+pair<double, double> Map::getFrenetNear(int &segment, double x, double y) const {
     int prev_wp = -1;
+    if (segment >= 0 && segment < (int) map_waypoints_x.size()) {
+        prev_wp = LocalClosestSegment(segment, x, y, FRENET_LOCAL_SEARCH_SEGMENTS);
+    }
 
-    while (s > map_waypoints_s[prev_wp + 1] && (prev_wp < (int) (map_waypoints_s.size() - 1))) {
-        prev_wp++;
+    // Teleported, or found a different stretch of road that just happens to be nearby
+    if (prev_wp < 0 || projectOntoSegment(prev_wp, x, y).dist2
+                       > FRENET_LOCAL_SEARCH_DISTANCE * FRENET_LOCAL_SEARCH_DISTANCE) {
+        prev_wp = ClosestSegment(x, y);
     }
 
+    segment = prev_wp;
+    return segmentFrenet(prev_wp, x, y);
+}
+
+void Map::getFrenetStates(const vector<double> &x,
+                          const vector<double> &y,
+                          const vector<double> &v_x,
+                          const vector<double> &v_y,
+                          vector<int> &segments,
+                          vector<FrenetState> &states) const {
+    int count = x.size();
+    int num_wps = map_waypoints_x.size();
+    segments.resize(max(segments.size(), x.size()), -1);
+    states.resize(count);
+    if (num_wps == 0) {
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        pair<double, double> frenet = getFrenetNear(segments[i], x[i], y[i]);
+
+        // Velocity in the segment's own frame, along it and to its right
+        int prev_wp = segments[i];
+        int next_wp = prev_wp + 1 == num_wps ? 0 : prev_wp + 1;
+        double inv_length = sqrt(segment_inv_length2[prev_wp]);
+        double t_x = (map_waypoints_x[next_wp] - map_waypoints_x[prev_wp]) * inv_length;
+        double t_y = (map_waypoints_y[next_wp] - map_waypoints_y[prev_wp]) * inv_length;
+
+        FrenetState &state = states[i];
+        state.s = frenet.first;
+        state.d = frenet.second;
+        state.s_dot = v_x[i] * t_x + v_y[i] * t_y;
+        state.d_dot = v_x[i] * t_y - v_y[i] * t_x;
+    }
+}
+
+int Map::WaypointSegment(double s) const {
+    s = wrap_s(s, track_length);
+
+    // Waypoints are sorted by s, so the segment starts at the last one strictly before s
+    int prev_wp = (int) (lower_bound(map_waypoints_s.begin(), map_waypoints_s.end(), s) - map_waypoints_s.begin()) - 1;
+
+    // s == 0 lands right on the first waypoint, and anything before a first waypoint that isn't at 0 is
+    // measured back from it, never from the waypoint before index 0
+    return max(prev_wp, 0);
+}
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+pair<double, double> Map::getXY(double s, double d) const {
+    s = wrap_s(s, track_length);
+    return segmentXY(WaypointSegment(s), s, d);
+}
+
+pair<double, double> Map::segmentXY(int prev_wp, double s, double d) const {
     int wp2 = (prev_wp + 1) % map_waypoints_x.size();
 
     double heading = atan2((map_waypoints_y[wp2] - map_waypoints_y[prev_wp]),
@@ -151,3 +412,23 @@ pair<double, double> Map::getXY(double s, double d) {
 
     return make_pair(x, y);
 }
+
+pair<double, double> Map::getLaneXY(double s, int lane) const {
+    const vector<double> &xs = lane_points_x[lane];
+    const vector<double> &ys = lane_points_y[lane];
+
+    s = wrap_s(s, track_length);
+
+    int i = (int) (s / LANE_POLYLINE_STEP);
+    if (i >= (int) xs.size()) {
+        i = xs.size() - 1;
+    }
+    int next = i + 1 == (int) xs.size() ? 0 : i + 1;
+
+    // Last step closes the loop, so it's usually shorter than LANE_POLYLINE_STEP
+    double seg_start = i * LANE_POLYLINE_STEP;
+    double seg_length = next == 0 ? track_length - seg_start : LANE_POLYLINE_STEP;
+    double t = (s - seg_start) / seg_length;
+
+    return make_pair(xs[i] + t * (xs[next] - xs[i]), ys[i] + t * (ys[next] - ys[i]));
+}
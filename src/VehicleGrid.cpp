@@ -0,0 +1,230 @@
+//
+// Frenet spatial hash of the sensed vehicles, see VehicleGrid.h
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include "VehicleGrid.h"
+
+using namespace std;
+
+static size_t hash_key(int key) {
+    uint32_t h = (uint32_t) key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+// Keep out sorted by gap and at most k long
+static void insert_nearest(vector<GridNeighbor> &out, int k, double gap, const GridVehicle *vehicle) {
+    if ((int) out.size() == k) {
+        if (gap >= out.back().gap) {
+            return;
+        }
+        out.pop_back();
+    }
+    GridNeighbor neighbor = {gap, vehicle};
+    auto at = upper_bound(out.begin(), out.end(), neighbor,
+                          [](const GridNeighbor &a, const GridNeighbor &b) { return a.gap < b.gap; });
+    out.insert(at, neighbor);
+}
+
+int VehicleGrid::bucket(double s) const {
+    return min((int) (s / bucket_length), num_buckets - 1);
+}
+
+const VehicleGrid::Cell *VehicleGrid::find(int key) const {
+    for (size_t slot = hash_key(key) & mask;; slot = (slot + 1) & mask) {
+        const Cell &cell = table[slot];
+        if (cell.key == key) {
+            return &cell;
+        }
+        if (cell.key < 0) {
+            return nullptr;
+        }
+    }
+}
+
+void VehicleGrid::begin(double track_length, int num_lanes, double bucket_length) {
+    this->track_length = track_length;
+    this->bucket_length = bucket_length;
+    num_buckets = max(1, (int) ceil(track_length / bucket_length));
+    rows = num_lanes + 2;
+
+    added.clear();
+    added_keys.clear();
+    vehicles.clear();
+    added.reserve(GRID_RESERVED_VEHICLES);
+    added_keys.reserve(GRID_RESERVED_VEHICLES);
+    added_slots.reserve(GRID_RESERVED_VEHICLES);
+    vehicles.reserve(GRID_RESERVED_VEHICLES);
+}
+
+void VehicleGrid::add(int id, int lane, double s, double d, double speed) {
+    lane = min(max(lane, -1), rows - 2);
+    GridVehicle vehicle = {id, lane, s, d, speed};
+    added.push_back(vehicle);
+    added_keys.push_back(key(bucket(wrap_s(s, track_length)), lane));
+}
+
+void VehicleGrid::build() {
+    hashed = (int) added.size() >= GRID_MIN_HASHED_VEHICLES;
+    if (!hashed) {
+        vehicles.clear();
+        return;
+    }
+
+    size_t size = 2 * GRID_RESERVED_VEHICLES;
+    while (size < 2 * added.size()) {
+        size <<= 1;
+    }
+    table.assign(size, Cell());
+    mask = size - 1;
+
+    // Count the vehicles in every cell, claiming slots as keys show up
+    added_slots.resize(added.size());
+    for (size_t i = 0; i < added.size(); i++) {
+        size_t slot = hash_key(added_keys[i]) & mask;
+        while (table[slot].key >= 0 && table[slot].key != added_keys[i]) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot].key = added_keys[i];
+        table[slot].count++;
+        added_slots[i] = (int) slot;
+    }
+
+    // Give every cell its range of vehicles, then fill them in
+    int start = 0;
+    for (Cell &cell : table) {
+        cell.start = start;
+        start += cell.count;
+        cell.count = 0;
+    }
+
+    vehicles.resize(added.size());
+    for (size_t i = 0; i < added.size(); i++) {
+        Cell &cell = table[added_slots[i]];
+        vehicles[cell.start + cell.count++] = added[i];
+    }
+}
+
+void VehicleGrid::nearest_ahead(int lane, double s, double max_distance, int k, vector<GridNeighbor> &out) const {
+    out.clear();
+    if (added.empty() || k <= 0 || lane < -1 || lane > rows - 2) {
+        return;
+    }
+
+    s = wrap_s(s, track_length);
+    if (!hashed) {
+        for (const GridVehicle &vehicle : added) {
+            double gap = wrap_s(vehicle.s - s, track_length);
+            if (vehicle.lane == lane && gap < max_distance) {
+                insert_nearest(out, k, gap, &vehicle);
+            }
+        }
+        return;
+    }
+
+    int b = bucket(s);
+    // Distance from s to the start of the bucket after b, nothing further on can be nearer than that
+    double reached = b == num_buckets - 1 ? track_length - s : (b + 1) * bucket_length - s;
+
+    for (int visited = 0; visited < num_buckets; visited++) {
+        const Cell *cell = find(key(b, lane));
+        if (cell != nullptr) {
+            for (int i = cell->start; i < cell->start + cell->count; i++) {
+                double gap = wrap_s(vehicles[i].s - s, track_length);
+                if (gap < max_distance) {
+                    insert_nearest(out, k, gap, &vehicles[i]);
+                }
+            }
+        }
+        if (reached >= max_distance || ((int) out.size() == k && reached >= out.back().gap)) {
+            break;
+        }
+        b = b + 1 == num_buckets ? 0 : b + 1;
+        reached += bucket_span(b);
+    }
+}
+
+bool VehicleGrid::nearest_ahead(int lane, double s, double max_distance, GridNeighbor &nearest) const {
+    nearest.vehicle = nullptr;
+    nearest.gap = max_distance;
+    if (added.empty() || lane < -1 || lane > rows - 2) {
+        return false;
+    }
+
+    s = wrap_s(s, track_length);
+    if (!hashed) {
+        for (const GridVehicle &vehicle : added) {
+            double gap = wrap_s(vehicle.s - s, track_length);
+            if (vehicle.lane == lane && gap < nearest.gap) {
+                nearest.gap = gap;
+                nearest.vehicle = &vehicle;
+            }
+        }
+        return nearest.vehicle != nullptr;
+    }
+
+    int b = bucket(s);
+    double reached = b == num_buckets - 1 ? track_length - s : (b + 1) * bucket_length - s;
+
+    for (int visited = 0; visited < num_buckets; visited++) {
+        const Cell *cell = find(key(b, lane));
+        if (cell != nullptr) {
+            for (int i = cell->start; i < cell->start + cell->count; i++) {
+                double gap = wrap_s(vehicles[i].s - s, track_length);
+                if (gap < nearest.gap) {
+                    nearest.gap = gap;
+                    nearest.vehicle = &vehicles[i];
+                }
+            }
+        }
+        // Nothing in a further bucket can beat what's been found, or be within max_distance
+        if (reached >= nearest.gap) {
+            break;
+        }
+        b = b + 1 == num_buckets ? 0 : b + 1;
+        reached += bucket_span(b);
+    }
+
+    return nearest.vehicle != nullptr;
+}
+
+void VehicleGrid::nearest_behind(int lane, double s, double max_distance, int k, vector<GridNeighbor> &out) const {
+    out.clear();
+    if (added.empty() || k <= 0 || lane < -1 || lane > rows - 2) {
+        return;
+    }
+
+    s = wrap_s(s, track_length);
+    if (!hashed) {
+        for (const GridVehicle &vehicle : added) {
+            double gap = wrap_s(s - vehicle.s, track_length);
+            if (vehicle.lane == lane && gap > 0 && gap < max_distance) {
+                insert_nearest(out, k, gap, &vehicle);
+            }
+        }
+        return;
+    }
+
+    int b = bucket(s);
+    // Distance from s back to the end of the bucket before b
+    double reached = s - b * bucket_length;
+
+    for (int visited = 0; visited < num_buckets; visited++) {
+        const Cell *cell = find(key(b, lane));
+        if (cell != nullptr) {
+            for (int i = cell->start; i < cell->start + cell->count; i++) {
+                double gap = wrap_s(s - vehicles[i].s, track_length);
+                if (gap > 0 && gap < max_distance) {
+                    insert_nearest(out, k, gap, &vehicles[i]);
+                }
+            }
+        }
+        if (reached >= max_distance || ((int) out.size() == k && reached >= out.back().gap)) {
+            break;
+        }
+        b = b == 0 ? num_buckets - 1 : b - 1;
+        reached += bucket_span(b);
+    }
+}
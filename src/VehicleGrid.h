@@ -0,0 +1,142 @@
+//
+// Per-tick spatial hash of the sensed vehicles in Frenet coordinates, keyed by (s bucket, lane), so
+// neighborhood questions ("anyone within 30 m ahead in lane 2?", "the 2 nearest cars behind in lane 0")
+// only look at the few buckets they cover instead of every tracked vehicle. Rebuilt from scratch every
+// telemetry message in O(vehicles), and allocation free once its buffers have grown to the traffic.
+// With only a few cars around, like the simulator's dozen, hashing costs more than it saves, so below
+// GRID_MIN_HASHED_VEHICLES the grid isn't built and the queries scan the cars in the order they were added.
+//
+// Lanes are whatever the caller classified them as, -1 and num_lanes included for cars off either side
+// of the road, so the grid doesn't need to know the lane model.
+//
+
+#ifndef PATH_PLANNING_VEHICLE_GRID_H
+#define PATH_PLANNING_VEHICLE_GRID_H
+
+#include <vector>
+#include "Frenet.h"
+
+using namespace std;
+
+// Length of road covered by one bucket, about a car length plus a gap at highway speed
+static const double GRID_BUCKET_LENGTH = 10.;
+// Room made up front, so the number of cars in sensor range changing doesn't allocate mid-drive
+static const int GRID_RESERVED_VEHICLES = 64;
+// Fewest vehicles worth hashing. Below this scanning them all is quicker than clearing the table, and
+// beyond VehicleTracker's 64 tracks both are dwarfed by the tracker evicting cars every message.
+static const int GRID_MIN_HASHED_VEHICLES = 64;
+
+struct GridVehicle {
+    int id;
+    int lane;
+    double s; // as added, not necessarily wrapped
+    double d;
+    double speed;
+};
+
+struct GridNeighbor {
+    double gap; // distance along the track from the query's s, always positive
+    const GridVehicle *vehicle;
+};
+
+class VehicleGrid {
+
+private:
+    struct Cell {
+        int key = -1; // bucket * rows + lane + 1, -1 if the slot is empty
+        int start = 0;
+        int count = 0;
+    };
+
+    double track_length = 0;
+    double bucket_length = GRID_BUCKET_LENGTH;
+    int num_buckets = 1;
+    int rows = 0; // lanes plus one either side for off-road cars
+
+    vector<GridVehicle> added;
+    vector<int> added_keys;
+    vector<int> added_slots;
+    vector<GridVehicle> vehicles; // grouped by cell, in the order they were added within one
+    vector<Cell> table;           // open addressing, a power of two at least twice the vehicles
+    size_t mask = 0;
+    bool hashed = false;          // otherwise vehicles is empty and queries scan added
+
+    int bucket(double s) const;
+    int key(int bucket, int lane) const { return bucket * rows + lane + 1; }
+    const Cell *find(int key) const;
+
+    // Length of road in bucket b, the last one is short unless the track divides evenly
+    double bucket_span(int b) const {
+        return b == num_buckets - 1 ? track_length - b * bucket_length : bucket_length;
+    }
+
+public:
+    // Start over for a new tick on a track of this length with lanes 0..num_lanes - 1
+    void begin(double track_length, int num_lanes, double bucket_length = GRID_BUCKET_LENGTH);
+
+    // Lane can be -1 or num_lanes for a car off the road, anything further out is clamped to those
+    void add(int id, int lane, double s, double d, double speed);
+
+    // Hash everything added since begin, call before querying
+    void build();
+
+    size_t size() const { return added.size(); }
+
+    // Call f(const GridVehicle &) for every vehicle in lane with s in [start, start + length) along the track,
+    // stopping early and returning true as soon as f does
+    template<typename F>
+    bool any_in_window(int lane, double start, double length, F f) const;
+
+    // Up to k vehicles in lane with s in [s, s + max_distance) going forward, nearest first, into out
+    void nearest_ahead(int lane, double s, double max_distance, int k, vector<GridNeighbor> &out) const;
+
+    // Just the nearest one of those, without needing a vector, false if there's none
+    bool nearest_ahead(int lane, double s, double max_distance, GridNeighbor &nearest) const;
+
+    // Up to k vehicles in lane with s in (s - max_distance, s) going backwards, nearest first, into out
+    void nearest_behind(int lane, double s, double max_distance, int k, vector<GridNeighbor> &out) const;
+};
+
+template<typename F>
+bool VehicleGrid::any_in_window(int lane, double start, double length, F f) const {
+    if (added.empty() || lane < -1 || lane > rows - 2) {
+        return false;
+    }
+
+    start = wrap_s(start, track_length);
+    if (!hashed) {
+        for (const GridVehicle &vehicle : added) {
+            if (vehicle.lane == lane && s_in_window(vehicle.s, start, length, track_length) && f(vehicle)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int b = bucket(start);
+    // Road between start and the end of the bucket it's in
+    double covered = (b + 1) * bucket_length - start;
+    if (b == num_buckets - 1) {
+        covered = track_length - start;
+    }
+
+    for (int visited = 0; visited < num_buckets; visited++) {
+        const Cell *cell = find(key(b, lane));
+        if (cell != nullptr) {
+            for (int i = cell->start; i < cell->start + cell->count; i++) {
+                if (s_in_window(vehicles[i].s, start, length, track_length) && f(vehicles[i])) {
+                    return true;
+                }
+            }
+        }
+        if (covered >= length) {
+            break;
+        }
+        b = b + 1 == num_buckets ? 0 : b + 1;
+        covered += bucket_span(b);
+    }
+
+    return false;
+}
+
+#endif //PATH_PLANNING_VEHICLE_GRID_H
@@ -0,0 +1,129 @@
+//
+// Incremental per-vehicle filtering for sensor fusion data.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include "VehicleTracker.h"
+
+using namespace std;
+
+double VehicleTrack::predict_s(double t) const {
+    double s = latest().s;
+    if (accel < 0 && speed + accel * t < 0) {
+        // Would stop before t, so it just sits where it stops
+        return s + speed * speed / (-2 * accel);
+    }
+
+    return s + speed * t + .5 * accel * t * t;
+}
+
+// Where id's probe chain starts
+static int home_slot(int id) {
+    uint32_t h = (uint32_t) id * 2654435761u;
+    return (h ^ (h >> 16)) % MAX_TRACKED_VEHICLES;
+}
+
+// Slots are never emptied, only go stale and get reused, so a chain runs until the first slot never used
+int VehicleTracker::find_slot(int id) const {
+    for (int i = 0, slot = home_slot(id); i < MAX_TRACKED_VEHICLES; i++, slot = (slot + 1) % MAX_TRACKED_VEHICLES) {
+        const VehicleTrack &track = tracks[slot];
+        if (track.count == 0) {
+            return -1;
+        }
+        if (track.id == id) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+int VehicleTracker::claim_slot(int id) {
+    int found = find_slot(id);
+    if (found >= 0) {
+        return found;
+    }
+
+    int oldest = -1;
+    for (int i = 0, slot = home_slot(id); i < MAX_TRACKED_VEHICLES; i++, slot = (slot + 1) % MAX_TRACKED_VEHICLES) {
+        const VehicleTrack &track = tracks[slot];
+        if (track.count == 0 || stale(track)) {
+            return slot;
+        }
+        if (oldest < 0 || track.last_seen_tick < tracks[oldest].last_seen_tick) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+void VehicleTracker::begin_tick(double dt) {
+    tick++;
+    now += dt;
+}
+
+const VehicleTrack &VehicleTracker::observe(int id, double s, double d, double v_x, double v_y) {
+    VehicleTrack &track = tracks[claim_slot(id)];
+    double measured_speed = sqrt(v_x * v_x + v_y * v_y);
+
+    bool is_new = track.id != id || stale(track) || track.count == 0;
+    if (is_new) {
+        track.id = id;
+        track.head = 0;
+        track.count = 1;
+        track.samples[0] = {now, s, d, measured_speed};
+        track.speed = measured_speed;
+        track.accel = 0;
+        track.d_dot = 0;
+        track.last_seen_tick = tick;
+        return track;
+    }
+
+    if (track.last_seen_tick == tick) {
+        // Same id reported twice in one tick, keep the newest values but don't advance history
+        track.samples[track.head] = {now, s, d, measured_speed};
+        return track;
+    }
+
+    double dt = now - track.latest().t;
+    track.head = (track.head + 1) % TRACK_HISTORY;
+    track.samples[track.head] = {now, s, d, measured_speed};
+    track.count = min(track.count + 1, TRACK_HISTORY);
+    track.last_seen_tick = tick;
+
+    double prev_speed = track.speed;
+    track.speed += SPEED_FILTER_GAIN * (measured_speed - track.speed);
+
+    if (dt > 0) {
+        double measured_accel = (track.speed - prev_speed) / dt;
+        measured_accel = max(-MAX_TRACKED_ACCEL, min(MAX_TRACKED_ACCEL, measured_accel));
+        track.accel += ACCEL_FILTER_GAIN * (measured_accel - track.accel);
+    }
+
+    // Lateral rate over the whole window is far less noisy than sample to sample.
+    const VehicleSample &oldest = track.oldest();
+    double window = now - oldest.t;
+    if (window > 0) {
+        track.d_dot = (d - oldest.d) / window;
+    }
+
+    return track;
+}
+
+const VehicleTrack *VehicleTracker::find(int id) const {
+    int slot = find_slot(id);
+    if (slot < 0 || stale(tracks[slot])) {
+        return nullptr;
+    }
+
+    return &tracks[slot];
+}
+
+void VehicleTracker::clear() {
+    for (VehicleTrack &track : tracks) {
+        track = VehicleTrack();
+    }
+    tick = 0;
+    now = 0;
+}
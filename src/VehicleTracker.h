@@ -0,0 +1,80 @@
+//
+// Keeps a short history of every sensor-fusion vehicle across telemetry ticks so prediction
+// can use filtered speed/acceleration instead of re-deriving everything from a single sample.
+//
+
+#ifndef PATH_PLANNING_VEHICLE_TRACKER_H
+#define PATH_PLANNING_VEHICLE_TRACKER_H
+
+// Slots in the open addressing table of tracks keyed by sensor-fusion id, at least twice the vehicles
+// in sensor range at once, so probe chains stay short. Ids can be anything, the simulator uses 0-11.
+static const int MAX_TRACKED_VEHICLES = 64;
+// Number of samples kept per vehicle in its ring buffer.
+static const int TRACK_HISTORY = 8;
+// Vehicles not reported for this many ticks are treated as gone.
+static const int TRACK_STALE_TICKS = 5;
+
+// Filter gains, 0 would ignore new measurements, 1 takes them as-is.
+static const double SPEED_FILTER_GAIN = .5;
+static const double ACCEL_FILTER_GAIN = .3;
+// Physically plausible bound so a single bad sample can't throw predictions way off (m/s^2).
+static const double MAX_TRACKED_ACCEL = 10.;
+
+struct VehicleSample {
+    double t; // seconds since the tracker was created
+    double s;
+    double d;
+    double speed; // m/s, raw magnitude of (v_x, v_y)
+};
+
+struct VehicleTrack {
+    int id = -1;
+    unsigned int last_seen_tick = 0;
+
+    // Ring buffer of the latest TRACK_HISTORY samples, head is the most recent one.
+    VehicleSample samples[TRACK_HISTORY];
+    int head = 0;
+    int count = 0;
+
+    // Filtered state, updated incrementally on every observation.
+    double speed = 0;   // m/s along the road
+    double accel = 0;   // m/s^2 along the road
+    double d_dot = 0;   // m/s lateral, positive is drifting to the right
+
+    const VehicleSample &latest() const { return samples[head]; }
+    const VehicleSample &oldest() const { return samples[(head + TRACK_HISTORY - count + 1) % TRACK_HISTORY]; }
+
+    // Predicted s after t seconds, constant acceleration but never rolling backwards.
+    double predict_s(double t) const;
+};
+
+class VehicleTracker {
+
+private:
+    VehicleTrack tracks[MAX_TRACKED_VEHICLES];
+    unsigned int tick = 0;
+    double now = 0;
+
+    bool stale(const VehicleTrack &track) const { return tick - track.last_seen_tick > TRACK_STALE_TICKS; }
+
+    // Slot holding id, stale or not, -1 if it has none
+    int find_slot(int id) const;
+
+    // Slot to start or continue id's track in: its own, else the first stale or empty one along its probe
+    // chain, else the least recently seen one if every slot is live
+    int claim_slot(int id);
+
+public:
+    // Start a new telemetry tick, dt is the simulated time elapsed since the previous one.
+    void begin_tick(double dt);
+
+    // Record one sensor-fusion entry for the current tick and return its updated track.
+    const VehicleTrack &observe(int id, double s, double d, double v_x, double v_y);
+
+    // nullptr if the vehicle has never been seen or has gone stale.
+    const VehicleTrack *find(int id) const;
+
+    void clear();
+};
+
+#endif //PATH_PLANNING_VEHICLE_TRACKER_H
@@ -0,0 +1,112 @@
+//
+// Fuzzes the binary protocol readers. The first byte picks the negotiated flags, the rest is the websocket
+// message, read as every message type. Besides staying inside the message, anything read has to come back
+// the same when written out and read again (the path only to its length with BINARY_DELTA, which re-rounds
+// offsets), and valid telemetry is planned on and its control message read back as the path it holds
+// (exactly with full doubles, to its length when the planner's points get rounded to f32).
+//
+
+#include <cstring>
+#include <string>
+#include "FuzzCommon.h"
+#include "../PathPlanner.h"
+#include "../Protocol.h"
+#include "../Telemetry.h"
+
+using namespace std;
+
+// Bit for bit, so NaNs read from the message compare equal to themselves
+static bool same(double a, double b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool same(const vector<double> &a, const vector<double> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!same(a[i], b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same(const Telemetry &a, const Telemetry &b, bool exact_path) {
+    if (!same(a.x, b.x) || !same(a.y, b.y) || !same(a.s, b.s) || !same(a.d, b.d) || !same(a.yaw, b.yaw)
+        || !same(a.speed, b.speed) || !same(a.end_path_s, b.end_path_s) || !same(a.end_path_d, b.end_path_d)) {
+        return false;
+    }
+    if (exact_path ? !same(a.previous_path_x, b.previous_path_x) || !same(a.previous_path_y, b.previous_path_y)
+                   : a.previous_path_x.size() != b.previous_path_x.size()) {
+        return false;
+    }
+    if (a.sensor_fusion.size() != b.sensor_fusion.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.sensor_fusion.size(); i++) {
+        const SensedVehicle &u = a.sensor_fusion[i];
+        const SensedVehicle &v = b.sensor_fusion[i];
+        if (u.id != v.id || !same(u.x, v.x) || !same(u.y, v.y) || !same(u.v_x, v.v_x) || !same(u.v_y, v.v_y)
+            || !same(u.s, v.s) || !same(u.d, v.d)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    uint8_t flags = data[0] & BINARY_SUPPORTED_FLAGS;
+    const char *message = (const char *) data + 1;
+    size_t length = size - 1;
+    bool exact_path = !(flags & BINARY_DELTA);
+    string frame;
+
+    BinaryHeader header;
+    read_binary_header(message, length, header);
+
+    uint8_t hello_flags;
+    if (read_binary_hello(message, length, hello_flags)) {
+        uint8_t again;
+        write_binary_hello(frame, BINARY_HELLO, hello_flags);
+        fuzz_check(read_binary_hello(frame.data(), frame.size(), again) && again == hello_flags,
+                   "HELLO reads back");
+    }
+
+    Telemetry telemetry;
+    bool read = read_binary_telemetry(message, length, flags, telemetry);
+    if (read) {
+        Telemetry again;
+        write_binary_telemetry(frame, telemetry, flags, 1);
+        fuzz_check(read_binary_telemetry(frame.data(), frame.size(), flags, again)
+                   && same(telemetry, again, exact_path), "TELEMETRY reads back");
+    }
+
+    // A CONTROL with BINARY_TAIL keeps points of the previous path, whatever the telemetry left there
+    vector<double> next_x = telemetry.previous_path_x;
+    vector<double> next_y = telemetry.previous_path_y;
+    if (read_binary_control(message, length, flags, next_x, next_y)) {
+        fuzz_check(next_x.size() == next_y.size(), "as many CONTROL x's as y's");
+    }
+
+    if (!read || !valid_telemetry(telemetry)) {
+        return 0;
+    }
+
+    PlannerState planner;
+    planner.horizon.timed = false;
+    const pair<vector<double>, vector<double>> &path = plan_path(fuzz_map(), telemetry, planner);
+
+    size_t kept = count_kept_points(path.first, path.second, telemetry.previous_path_x, telemetry.previous_path_y);
+    write_binary_control(frame, path.first, path.second, flags, 1, kept);
+    next_x = telemetry.previous_path_x;
+    next_y = telemetry.previous_path_y;
+    bool exact_control = !(flags & (BINARY_FLOAT32 | BINARY_DELTA));
+    fuzz_check(read_binary_control(frame.data(), frame.size(), flags, next_x, next_y)
+               && (exact_control ? same(next_x, path.first) && same(next_y, path.second)
+                                 : next_x.size() == path.first.size()), "CONTROL reads back as the path");
+    return 0;
+}
@@ -0,0 +1,79 @@
+//
+// Shared by the fuzz targets: the map they plan and convert on, reading numbers off the fuzzer's bytes,
+// and the check that stops a run when a property doesn't hold. Every target defines
+// LLVMFuzzerTestOneInput, linked with libFuzzer when building with clang or with FuzzMain.cpp otherwise.
+//
+
+#ifndef PATH_PLANNING_FUZZ_COMMON_H
+#define PATH_PLANNING_FUZZ_COMMON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "../Map.h"
+
+using namespace std;
+
+#ifndef PLANNER_FUZZ_MAP
+#define PLANNER_FUZZ_MAP "../data/highway_map.csv"
+#endif
+
+// The highway map, loaded on first use and kept for the whole run
+inline const Map &fuzz_map() {
+    static Map *map = nullptr;
+    if (map == nullptr) {
+        map = new Map();
+        if (!map->load_map(PLANNER_FUZZ_MAP)) {
+            exit(1);
+        }
+    }
+    return *map;
+}
+
+// Aborts, so the fuzzer saves the input, if a property doesn't hold
+inline void fuzz_check(bool holds, const char *property) {
+    if (!holds) {
+        cerr << "Property broken: " << property << endl;
+        abort();
+    }
+}
+
+// Numbers taken off the front of the input, zeros once it runs out
+class FuzzInput {
+
+private:
+    const uint8_t *data;
+    size_t size;
+
+public:
+    FuzzInput(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    bool empty() const { return size == 0; }
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        size_t n = size < sizeof(value) ? size : sizeof(value);
+        memcpy(&value, data, n);
+        data += n;
+        size -= n;
+        return value;
+    }
+
+    uint8_t u8() {
+        if (size == 0) {
+            return 0;
+        }
+        size--;
+        return *data++;
+    }
+
+    // Spread over [low, high]
+    double uniform(double low, double high) { return low + (high - low) * (u32() / 4294967295.); }
+
+    // One of low..high
+    int integer(int low, int high) { return low + (int) (u32() % (uint32_t) (high - low + 1)); }
+};
+
+#endif //PATH_PLANNING_FUZZ_COMMON_H
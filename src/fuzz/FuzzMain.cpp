@@ -0,0 +1,154 @@
+//
+// Stand-in for libFuzzer's driver when the compiler doesn't come with one (gcc), so the fuzz targets and
+// their sanitizer and property checks run anywhere, only without coverage guidance:
+//
+//   fuzz_<target> [-runs=<n>] [-seed=<n>] [file or directory]...
+//
+// Every file given (directories are read one level deep) is run as is. Then, for -runs times (10000
+// by default, 0 only runs the files), a randomly mutated copy of one of them is, or random bytes if no
+// files were given. An input that breaks something is written to crash-<run> before aborting.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace std;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const int FUZZ_DEFAULT_RUNS = 10000;
+static const size_t FUZZ_MAX_INPUT = 1 << 16;
+static const int FUZZ_MAX_MUTATIONS = 8;
+
+static bool read_input(const string &file, vector<uint8_t> &input) {
+    ifstream in(file, ios::binary);
+    if (!in) {
+        return false;
+    }
+    input.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+static void add_inputs(const string &path, vector<vector<uint8_t>> &inputs) {
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR *dir = opendir(path.c_str());
+        if (dir == nullptr) {
+            return;
+        }
+        while (dirent *entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                add_inputs(path + "/" + entry->d_name, inputs);
+            }
+        }
+        closedir(dir);
+        return;
+    }
+
+    vector<uint8_t> input;
+    if (read_input(path, input)) {
+        inputs.push_back(input);
+    } else {
+        cerr << "Could not read " << path << endl;
+    }
+}
+
+// Byte flips, overwrites, inserts, deletes, cuts and copies of a piece elsewhere, what breaks parsers most
+static void mutate(vector<uint8_t> &input, mt19937 &random) {
+    int mutations = 1 + random() % FUZZ_MAX_MUTATIONS;
+    for (int m = 0; m < mutations; m++) {
+        size_t size = input.size();
+        size_t at = size > 0 ? random() % size : 0;
+        switch (random() % 6) {
+            case 0:
+                if (size > 0) {
+                    input[at] ^= 1 << (random() % 8);
+                }
+                break;
+            case 1:
+                if (size > 0) {
+                    // Mostly characters that mean something in JSON or a number
+                    static const char interesting[] = "[]{},:\"-.0123456789eE";
+                    input[at] = random() % 2 ? interesting[random() % (sizeof(interesting) - 1)] : random();
+                }
+                break;
+            case 2:
+                if (size < FUZZ_MAX_INPUT) {
+                    input.insert(input.begin() + at, (uint8_t) random());
+                }
+                break;
+            case 3:
+                if (size > 0) {
+                    input.erase(input.begin() + at, input.begin() + min(size, at + 1 + random() % 16));
+                }
+                break;
+            case 4:
+                input.resize(at);
+                break;
+            default:
+                if (size > 0 && size < FUZZ_MAX_INPUT) {
+                    size_t from = random() % size;
+                    size_t length = min(size - from, (size_t) (1 + random() % 64));
+                    vector<uint8_t> piece(input.begin() + from, input.begin() + from + length);
+                    input.insert(input.begin() + at, piece.begin(), piece.end());
+                }
+                break;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int runs = FUZZ_DEFAULT_RUNS;
+    unsigned int seed = random_device()();
+    vector<vector<uint8_t>> inputs;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 6, "-runs=") == 0) {
+            runs = atoi(arg.c_str() + 6);
+        } else if (arg.compare(0, 6, "-seed=") == 0) {
+            seed = strtoul(arg.c_str() + 6, nullptr, 10);
+        } else if (arg[0] == '-') {
+            cerr << "Ignoring " << arg << ", only -runs and -seed are supported without libFuzzer" << endl;
+        } else {
+            add_inputs(arg, inputs);
+        }
+    }
+
+    for (const vector<uint8_t> &input : inputs) {
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    cout << "Running " << runs << " mutated inputs from " << inputs.size() << " files, -seed=" << seed << endl;
+    mt19937 random(seed);
+    vector<uint8_t> input;
+    for (int run = 0; run < runs; run++) {
+        if (inputs.empty()) {
+            input.resize(random() % 4096);
+            for (uint8_t &byte : input) {
+                byte = random();
+            }
+        } else {
+            input = inputs[random() % inputs.size()];
+            mutate(input, random);
+        }
+
+        // Saved before running, the sanitizers and properties abort without coming back here
+        string crash = "crash-" + to_string(run);
+        ofstream(crash, ios::binary).write((const char *) input.data(), input.size());
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        remove(crash.c_str());
+    }
+    cout << "Done, nothing broke" << endl;
+    return 0;
+}
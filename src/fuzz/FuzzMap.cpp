@@ -0,0 +1,119 @@
+//
+// Property tests for the Map conversions, driven by the fuzzer's bytes: one byte picks a check, the next
+// few where it runs, over and over until the input runs out. Positions go as far out as TELEMETRY_MAX_VALUE,
+// the furthest valid_telemetry lets a car be:
+//
+//  - getXY is finite and WaypointSegment a waypoint index, for any s and d
+//  - getFrenet is finite with s on the track, for any x and y
+//  - a point on the reference line (d = 0) converts back to the s it came from, up to how far the map's s
+//    spacing is from the straight segment lengths
+//  - getLaneXY is getXY at the lane center, at the points its polylines are precomputed at
+//  - getFrenetNear gives the same as the whole-map search whatever segment it starts from, valid or not,
+//    and getFrenetStates the same as getFrenetNear for a batch
+//
+
+#include <math.h>
+#include <vector>
+#include "FuzzCommon.h"
+#include "../Telemetry.h"
+
+using namespace std;
+
+// Reference line round trip error allowed in meters, the highway map's s spacing is up to .92 mm off
+static const double ROUND_TRIP_TOLERANCE = 2e-3;
+// Answers that have to match to rounding
+static const double SAME_TOLERANCE = 1e-9;
+static const int MAX_BATCH = 8;
+
+static bool finite(pair<double, double> p) {
+    return isfinite(p.first) && isfinite(p.second);
+}
+
+// Anywhere valid telemetry could put a car, usually near the road
+static pair<double, double> position(const Map &map, FuzzInput &input) {
+    if (input.u8() % 8 == 0) {
+        return make_pair(input.uniform(-TELEMETRY_MAX_VALUE, TELEMETRY_MAX_VALUE),
+                         input.uniform(-TELEMETRY_MAX_VALUE, TELEMETRY_MAX_VALUE));
+    }
+    double s = input.uniform(0, map.get_track_length());
+    double d = input.uniform(-50, 50);
+    return map.getXY(s, d);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    const Map &map = fuzz_map();
+    double length = map.get_track_length();
+    FuzzInput input(data, size);
+
+    while (!input.empty()) {
+        switch (input.u8() % 5) {
+            case 0: {
+                double s = input.uniform(-TELEMETRY_MAX_VALUE, TELEMETRY_MAX_VALUE);
+                double d = input.uniform(-TELEMETRY_MAX_VALUE, TELEMETRY_MAX_VALUE);
+                int segment = map.WaypointSegment(s);
+                fuzz_check(segment >= 0 && segment < map.num_waypoints(), "WaypointSegment is a waypoint");
+                fuzz_check(finite(map.getXY(s, d)), "getXY is finite");
+                break;
+            }
+            case 1: {
+                pair<double, double> xy = position(map, input);
+                pair<double, double> frenet = map.getFrenet(xy.first, xy.second, 0);
+                fuzz_check(frenet.first >= 0 && frenet.first < length && isfinite(frenet.second),
+                           "getFrenet is finite and on the track");
+                break;
+            }
+            case 2: {
+                // Laps either way, as s comes in from a car driving the loop
+                double s = input.uniform(-2 * length, 3 * length);
+                pair<double, double> xy = map.getXY(s, 0);
+                pair<double, double> frenet = map.getFrenet(xy.first, xy.second, 0);
+                fuzz_check(fabs(s_diff(frenet.first, s, length)) < ROUND_TRIP_TOLERANCE
+                           && fabs(frenet.second) < ROUND_TRIP_TOLERANCE,
+                           "getFrenet(getXY(s, 0)) is s");
+                break;
+            }
+            case 3: {
+                int points = (int) ceil(length / LANE_POLYLINE_STEP);
+                double s = input.integer(0, points - 1) * LANE_POLYLINE_STEP;
+                int lane = input.integer(0, map.get_num_lanes() - 1);
+                pair<double, double> lane_xy = map.getLaneXY(s, lane);
+                pair<double, double> xy = map.getXY(s, map.lane_center(lane));
+                fuzz_check(fabs(lane_xy.first - xy.first) < SAME_TOLERANCE
+                           && fabs(lane_xy.second - xy.second) < SAME_TOLERANCE,
+                           "getLaneXY is getXY at the polyline points");
+                break;
+            }
+            default: {
+                int count = input.integer(1, MAX_BATCH);
+                vector<double> x(count), y(count), v_x(count), v_y(count);
+                vector<int> segments(count);
+                for (int i = 0; i < count; i++) {
+                    pair<double, double> xy = position(map, input);
+                    x[i] = xy.first;
+                    y[i] = xy.second;
+                    v_x[i] = input.uniform(-100, 100);
+                    v_y[i] = input.uniform(-100, 100);
+                    segments[i] = input.integer(-2, map.num_waypoints() + 1);
+                }
+
+                vector<int> batch_segments = segments;
+                vector<FrenetState> states;
+                map.getFrenetStates(x, y, v_x, v_y, batch_segments, states);
+                for (int i = 0; i < count; i++) {
+                    pair<double, double> near = map.getFrenetNear(segments[i], x[i], y[i]);
+                    pair<double, double> frenet = map.getFrenet(x[i], y[i], 0);
+                    fuzz_check(fabs(near.first - frenet.first) < SAME_TOLERANCE
+                               && fabs(near.second - frenet.second) < SAME_TOLERANCE,
+                               "getFrenetNear is getFrenet from any segment");
+                    fuzz_check(states[i].s == near.first && states[i].d == near.second
+                               && batch_segments[i] == segments[i],
+                               "getFrenetStates is getFrenetNear");
+                    fuzz_check(isfinite(states[i].s_dot) && isfinite(states[i].d_dot),
+                               "getFrenetStates velocities are finite");
+                }
+                break;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+//
+// Fuzzes the socket.io text path of path_planning: a websocket message goes through hasData, json::parse,
+// decode_telemetry and valid_telemetry the way main.cpp takes it, and whatever gets through is planned on
+// and written back as a control frame. Beyond not crashing, the path sent back has to have as many x's as
+// y's and start with the whole previous path. Seed it with frames from the golden corpus, see README.md.
+//
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include "FuzzCommon.h"
+#include "../PathPlanner.h"
+#include "../Protocol.h"
+#include "../Telemetry.h"
+
+using namespace std;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    const Map &map = fuzz_map();
+
+    string s = hasData((const char *) data, size);
+    if (s.empty()) {
+        return 0;
+    }
+
+    Telemetry telemetry;
+    try {
+        json j = json::parse(s);
+        if (j.at(0).get<string>() != "telemetry") {
+            return 0;
+        }
+        decode_telemetry(j.at(1), telemetry);
+    } catch (const exception &e) {
+        return 0;
+    }
+    if (!valid_telemetry(telemetry)) {
+        return 0;
+    }
+
+    // A new car every input, so a crash reproduces from its input alone
+    PlannerState planner;
+    planner.horizon.timed = false;
+    const pair<vector<double>, vector<double>> &path = plan_path(map, telemetry, planner);
+
+    const vector<double> &previous_x = telemetry.previous_path_x;
+    const vector<double> &previous_y = telemetry.previous_path_y;
+    fuzz_check(path.first.size() == path.second.size(), "as many path x's as y's");
+    fuzz_check(path.first.size() >= previous_x.size()
+               && equal(previous_x.begin(), previous_x.end(), path.first.begin())
+               && equal(previous_y.begin(), previous_y.end(), path.second.begin()),
+               "the path starts with the previous path");
+
+    string frame;
+    write_control_frame(frame, path.first, path.second);
+    return 0;
+}
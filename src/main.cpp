@@ -1,81 +1,239 @@
 #include <fstream>
 #include <math.h>
+#include <uv.h>
 #include <uWS/uWS.h>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
-#include "Eigen-3.3/Eigen/Core"
-#include "Eigen-3.3/Eigen/QR"
-#include "json.hpp"
+#include "Json.h"
+#include "AllocationTracker.h"
+#include "Config.h"
+#include "Horizon.h"
 #include "Map.h"
-#include "spline.h"
+#include "MapStore.h"
+#include "PathPlanner.h"
+#include "Protocol.h"
+#include "Telemetry.h"
+#include "TelemetryQueue.h"
 
 using namespace std;
 
 using json = nlohmann::json;
 
-static const double MAX_SPEED = 49.5;
-static const double MAX_SPEED_CHANGE = .224; // About 5 m/s^2 accelleration
-static const double MPH_TO_METERS = 2.24;
-
-static const int NUM_LANES = 3; // FYI: Lanes are indexed at 0.
-static const double LANE_WIDTH = 4.; // in meters, useful for d part of Frenet coordinates
-static const double HALF_LANE_WIDTH = LANE_WIDTH / 2.; // to avoid having to compute /2 everytime.
-
-static const int NUM_POINTS = 50; // Number of points to use in path
-static const double TARGET_DISTANCE = 30.; // How far to look ahead with path calc.
-static const double SIMULATOR_TIME_STEP = .02; // Num seconds between each point that the simulator
 static const int WEBSOCKECT_OK_DISCONNECT_CODE = 1000;
 static const string MANUAL_WS_MESSAGE = "42[\"manual\",{}]";
 
-struct SF_CONSTANTS {
-    explicit SF_CONSTANTS(){};
+// Fleet mode, see Fleet below
+static const size_t INGEST_QUEUE_CAPACITY = 256; // per worker
+static const size_t REPLY_QUEUE_CAPACITY = 1024;
+static const uint64_t FLEET_STATS_INTERVAL = 10000; // replies between queue stats reports
+static const uint64_t ALLOCATION_STATS_INTERVAL = 1000; // messages between allocation reports, when tracked
+static const uint64_t HORIZON_STATS_INTERVAL = 1000; // messages between path length and planning time reports
+
+// The frame is handed to uWS as it is, no copies on our side
+void sendMessage(uWS::WebSocket<uWS::SERVER> ws, const string &msg, uWS::OpCode opCode = uWS::OpCode::TEXT) {
+    ws.send(msg.data(), msg.length(), opCode);
+}
 
-    static const int v_x = 3;
-    static const int v_y = 4;
-    static const int s = 5;
-    const int d = 6;
+// How a client wants its control replies, socket.io text unless it negotiated the binary protocol
+struct ReplyFormat {
+    bool binary = false;
+    uint8_t flags = 0;     // negotiated BINARY_* flags
+    uint32_t sequence = 0; // echoed back from the telemetry record
 };
 
-static const struct SF_CONSTANTS SENSOR_FUSION_IDX;
+// Plan the car's next path and serialize the control reply into frame, which is reused message to message
+void process_telemetry_data(const Map &map,
+                            const Telemetry &telemetry,
+                            PlannerState &state,
+                            const ReplyFormat &format,
+                            string &frame);
+
+// One connected car when running in fleet mode
+struct FleetConnection {
+    uWS::WebSocket<uWS::SERVER> ws;
+    bool open = true; // only touched on the websocket thread
+    int worker;       // every message from this car goes to the same worker, so they stay in order
+    uint64_t last_send_round = 0; // websocket thread only, see Fleet::send_replies
+    uint8_t binary_flags = 0;     // websocket thread only, set by a binary HELLO
+    bool binary = false;
+    PlannerState planner; // only touched by that worker
+
+    explicit FleetConnection(uWS::WebSocket<uWS::SERVER> ws) : ws(ws) {}
+};
+
+struct TelemetryJob {
+    shared_ptr<FleetConnection> connection;
+    Telemetry telemetry;
+    ReplyFormat format;
+};
+
+struct ReplyJob {
+    shared_ptr<FleetConnection> connection;
+    string frame; // circulates through the reply queue, so it keeps its capacity
+    bool binary;
+};
+
+// Fleet mode: many cars connect to the one planner. The websocket thread only decodes telemetry and
+// queues it for a pool of planning workers, which queue their replies back to be sent from the
+// websocket thread, so receiving and planning scale independently.
+class Fleet {
+
+private:
+    const MapStore &maps;
+    PlannerConfig config; // every car gets its own copy in its PlannerState
+
+    typedef TelemetryQueue<TelemetryJob, INGEST_QUEUE_CAPACITY> IngestQueue;
+    vector<unique_ptr<IngestQueue>> ingest; // one per worker
+    TelemetryQueue<ReplyJob, REPLY_QUEUE_CAPACITY> replies;
+
+    vector<thread> workers;
+    atomic<bool> running;
+    int next_worker = 0;
 
-// Checks if the SocketIO event has JSON data.
-// If there is data the JSON object in string format will be returned,
-// else the empty string "" will be returned.
-string hasData(string s);
+    // Wakes the websocket loop up when replies are waiting, open from start until stop
+    uv_async_t reply_async;
+    bool reply_async_open = false;
 
-void sendMessage(uWS::WebSocket<uWS::SERVER> ws, string msg) { ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT); }
+    // Reused for every message so decoding and sending don't allocate in steady state
+    TelemetryJob ingest_scratch;
+    string hello_frame;
+    vector<ReplyJob> ready; // replies drained in one go by send_replies
+    uint64_t send_round = 0;
+    uint64_t replies_sent = 0;
+    uint64_t replies_superseded = 0;
+    AllocationStats decode_allocations; // websocket thread, the other stages are counted per car
 
-json process_telemetry_data(Map map, json data, int &lane, double &ref_velocity);
+    void work(int worker);
 
-pair<vector<double>, vector<double>> generate_trajectory_for_lane(json data,
-                                                                  Map map,
-                                                                  const int lane,
-                                                                  const double ref_velocity);
+    // Queue ingest_scratch for its connection's worker
+    bool enqueue();
 
-void determine_lane_and_velocity(json data, int &lane, double &ref_velocity);
+public:
+    Fleet(const MapStore &maps, const PlannerConfig &config, int num_workers);
+    ~Fleet();
 
-int main() {
+    // Hook into the websocket loop and start the workers
+    void start(uWS::Hub &h);
+    // Join the workers and let go of the websocket loop, on the loop's thread
+    void stop();
+
+    void connect(uWS::WebSocket<uWS::SERVER> ws);
+    void disconnect(uWS::WebSocket<uWS::SERVER> ws);
+
+    // Queue a telemetry event's data for planning, false if that car's worker is backed up or it doesn't
+    // decode into valid_telemetry
+    bool submit(uWS::WebSocket<uWS::SERVER> ws, const json &data);
+    // Same for a binary TELEMETRY record
+    bool submit(uWS::WebSocket<uWS::SERVER> ws, const char *data, size_t length, uint32_t sequence);
+
+    // Answer a binary HELLO and switch the connection over
+    void hello(uWS::WebSocket<uWS::SERVER> ws, uint8_t flags);
+
+    // Allocations made decoding a message before handing it to submit
+    void count_decode(const AllocationCounts &counts) { decode_allocations.add(counts); }
+
+    // Websocket thread only
+    void send_replies();
+
+    void print_stats();
+};
+
+int main(int argc, char *argv[]) {
     uWS::Hub h;
     bool firstTimeConnecting = true;
 
-    Map map;
+    // Defaults, then the config file and command line, see Config.h
+    Config config;
+    if (!parse_config_args(argc, argv, config)) {
+        return -1;
+    }
 
-    // Waypoint map to read from
-    string map_file = "../data/highway_map.csv";
+    // Swapped for a fresh snapshot whenever the map file changes, without dropping anyone's connection
+    MapStore maps(config.map_file, config.num_lanes, config.lane_width);
+    if (!maps.load()) {
+        return -1;
+    }
+    uv_timer_t map_reload_timer;
+    if (config.map_reload_seconds > 0) {
+        map_reload_timer.data = &maps;
+        uv_timer_init(h.getLoop(), &map_reload_timer);
+        uint64_t interval_ms = (uint64_t) (config.map_reload_seconds * 1000);
+        uv_timer_start(&map_reload_timer, [](uv_timer_t *handle) {
+            static_cast<MapStore *>(handle->data)->check_for_changes();
+        }, interval_ms, interval_ms);
+    }
 
-    map.load_map(map_file);
+    // `--fleet <num_workers>` serves many cars at once, otherwise we drive the one simulator car inline
+    unique_ptr<Fleet> fleet;
+    if (config.fleet_workers > 0) {
+        fleet.reset(new Fleet(maps, config.planner, config.fleet_workers));
+        fleet->start(h);
+        cout << "Fleet mode with " << config.fleet_workers << " planning workers" << endl;
+    }
 
-    // start in lane 1
-    int lane = 1;
-    double ref_velocity = 0; //mph
+    PlannerState planner;
+    planner.config = config.planner;
+    Telemetry telemetry;
+    ReplyFormat format;
+    string frame;
 
-    h.onMessage( [&lane, &map, &ref_velocity] (
+    h.onMessage( [&maps, &planner, &telemetry, &format, &frame, &fleet] (
             uWS::WebSocket<uWS::SERVER> ws,
             char *data,
             size_t length,
             uWS::OpCode opCode) {
+        AllocationCounts decode_start = allocation_counts();
+        // Report allocations per stage every so often, when built to count them, and how the horizon adapts
+        auto count_decode = [&planner, &fleet, &decode_start]() {
+            AllocationCounts counts = allocations_since(decode_start);
+            if (fleet) {
+                fleet->count_decode(counts);
+                return;
+            }
+            const HorizonStats &horizon = planner.horizon.stats;
+            if (horizon.messages > 0 && horizon.messages % HORIZON_STATS_INTERVAL == 0) {
+                print_horizon_stats(cout, horizon);
+            }
+            planner.allocations[STAGE_DECODE].add(counts);
+            if (allocation_tracking_enabled() && planner.allocations[STAGE_DECODE].ticks % ALLOCATION_STATS_INTERVAL == 0) {
+                print_allocation_stats(cout, planner.allocations);
+            }
+        };
+
+        // Our own clients may speak the binary protocol instead, see Protocol.h
+        BinaryHeader header;
+        if (opCode == uWS::OpCode::BINARY && read_binary_header(data, length, header)) {
+            uint8_t flags;
+            if (header.type == BINARY_HELLO && read_binary_hello(data, length, flags)) {
+                flags &= BINARY_SUPPORTED_FLAGS;
+                if (fleet) {
+                    fleet->hello(ws, flags);
+                } else {
+                    format.binary = true;
+                    format.flags = flags;
+                    write_binary_hello(frame, BINARY_HELLO_ACK, flags);
+                    sendMessage(ws, frame, uWS::OpCode::BINARY);
+                }
+            } else if (header.type == BINARY_TELEMETRY && fleet) {
+                fleet->submit(ws, data, length, header.sequence);
+                count_decode();
+            } else if (header.type == BINARY_TELEMETRY && format.binary
+                       && read_binary_telemetry(data, length, format.flags, telemetry) && valid_telemetry(telemetry)) {
+                count_decode();
+                format.sequence = header.sequence;
+                process_telemetry_data(*maps.get(), telemetry, planner, format, frame);
+                sendMessage(ws, frame, uWS::OpCode::BINARY);
+            }
+            return;
+        }
+
         // "42" at the start of the message means there's a websocket message event.
         // The 4 signifies a websocket message
         // The 2 signifies a websocket event
@@ -83,21 +241,35 @@ int main() {
         //cout << sdata << endl;
         if (length && length > 2 && data[0] == '4' && data[1] == '2') {
 
-            auto s = hasData(data);
+            auto s = hasData(data, length);
 
             if (s != "") {
-                auto j = json::parse(s);
-
-                string event = j[0].get<string>();
-
-                if (event == "telemetry") {
-                    json msgJson = process_telemetry_data(map, j[1], lane, ref_velocity); // j[1] is the data JSON object
+                // Whatever a client sends, a message that doesn't parse or decode is dropped, not fatal
+                json j;
+                string event;
+                try {
+                    j = json::parse(s);
+                    event = j.at(0).get<string>();
+                    if (event == "telemetry" && !fleet) {
+                        // j[1] is the data JSON object
+                        decode_telemetry(j.at(1), telemetry);
+                    }
+                } catch (const exception &e) {
+                    cerr << "Dropped a malformed message: " << e.what() << endl;
+                    return;
+                }
 
-                    auto msg = "42[\"control\"," + msgJson.dump() + "]";
+                if (event == "telemetry" && fleet) {
+                    // Dropped if the car's worker is backed up, it keeps driving its previous path meanwhile
+                    fleet->submit(ws, j[1]);
+                    count_decode();
+                } else if (event == "telemetry" && valid_telemetry(telemetry)) {
+                    count_decode();
+                    process_telemetry_data(*maps.get(), telemetry, planner, ReplyFormat(), frame);
 
                     //this_thread::sleep_for(chrono::milliseconds(1000));
-                    sendMessage(ws, msg);
-                } else {
+                    sendMessage(ws, frame);
+                } else if (event != "telemetry") {
                     cout << "Unknown event type (" << event << ") received!!" << "\n";
                 }
             } else {
@@ -121,8 +293,10 @@ int main() {
         }
     });
 
-    h.onConnection([&h, &firstTimeConnecting](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
-        if (firstTimeConnecting) {
+    h.onConnection([&h, &firstTimeConnecting, &fleet](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+        if (fleet) {
+            fleet->connect(ws);
+        } else if (firstTimeConnecting) {
             cout << "Connected for first time!!!" << endl;
             firstTimeConnecting = false;
         } else {
@@ -130,8 +304,13 @@ int main() {
         }
     });
 
-    h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
+    h.onDisconnection([&h, &fleet](uWS::WebSocket<uWS::SERVER> ws, int code,
                            char *message, size_t length) {
+        if (fleet) {
+            fleet->disconnect(ws);
+            return;
+        }
+
         if (code == WEBSOCKECT_OK_DISCONNECT_CODE) {
             cout << "Disconnected normally." << endl;
         } else {
@@ -184,228 +363,259 @@ int main() {
         }
     });
 
-    int port = 4567;
+    // Ctrl-C or kill stops listening, closes the connections and every handle we put on the loop,
+    // so h.run() returns while the Fleet is still around to be stopped
+    uv_signal_t signals[2];
+    bool shutting_down = false;
+    function<void()> shutdown = [&]() {
+        if (shutting_down) {
+            return;
+        }
+        shutting_down = true;
+        if (fleet) {
+            fleet->stop();
+        }
+        if (config.map_reload_seconds > 0) {
+            uv_close((uv_handle_t *) &map_reload_timer, nullptr);
+        }
+        for (uv_signal_t &signal : signals) {
+            uv_close((uv_handle_t *) &signal, nullptr);
+        }
+        h.getDefaultGroup<uWS::SERVER>().close();
+    };
+    int signums[2] = {SIGINT, SIGTERM};
+    for (int i = 0; i < 2; i++) {
+        signals[i].data = &shutdown;
+        uv_signal_init(h.getLoop(), &signals[i]);
+        uv_signal_start(&signals[i], [](uv_signal_t *handle, int signum) {
+            (*static_cast<function<void()> *>(handle->data))();
+        }, signums[i]);
+    }
+
+    int port = config.port;
     if (h.listen(port)) {
         std::cout << "Listening to port " << port << std::endl;
     } else {
         std::cerr << "Failed to listen to port" << std::endl;
+        shutdown();
+        h.run();
         return -1;
     }
     h.run();
-}
 
-
-string hasData(string s) {
-    auto found_null = s.find("null");
-    auto b1 = s.find_first_of("[");
-    auto b2 = s.find_first_of("}");
-    if (found_null != string::npos) {
-        return "";
-    } else if (b1 != string::npos && b2 != string::npos) {
-        return s.substr(b1, b2 - b1 + 2);
+    if (fleet) {
+        fleet->stop();
     }
-    return "";
 }
 
-json process_telemetry_data(Map map, json data, int &lane, double &ref_velocity) {
-    determine_lane_and_velocity(data, lane, ref_velocity);
-
-    pair<vector<double>, vector<double>> trajectory = generate_trajectory_for_lane(data, map, lane, ref_velocity);
-
-    json msgJson;
-    msgJson["next_x"] = trajectory.first;
-    msgJson["next_y"] = trajectory.second;
-
-    return msgJson;
+Fleet::Fleet(const MapStore &maps, const PlannerConfig &config, int num_workers)
+        : maps(maps), config(config), running(false) {
+    for (int i = 0; i < num_workers; i++) {
+        ingest.emplace_back(new IngestQueue());
+    }
 }
 
-void determine_lane_and_velocity(json data, int &lane, double &ref_velocity) {
-    // Main car's localization Data
-    double car_s = data["s"];
+Fleet::~Fleet() {
+    stop();
+}
 
-    // Previous path data given to the Planner
-    auto previous_path_x = data["previous_path_x"];
-    auto previous_path_y = data["previous_path_y"];
-    // Previous path's end s and d values
-    double end_path_s = data["end_path_s"];
+void Fleet::start(uWS::Hub &h) {
+    reply_async.data = this;
+    uv_async_init(h.getLoop(), &reply_async, [](uv_async_t *handle) {
+        static_cast<Fleet *>(handle->data)->send_replies();
+    });
+    reply_async_open = true;
 
-    // Sensor Fusion Data, a list of all other cars on the same side of the road.
-    auto sensor_fusion = data["sensor_fusion"]; // format is [ id, x, y, vx, vy, s, d]
+    running = true;
+    for (int i = 0; i < (int) ingest.size(); i++) {
+        workers.emplace_back(&Fleet::work, this, i);
+    }
+}
 
-    int prev_size = previous_path_x.size();
+void Fleet::stop() {
+    running = false;
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
 
-    double last_s = prev_size > 0 ? end_path_s : car_s;
+    // The loop only exits once every handle on it is closed
+    if (reply_async_open) {
+        uv_close((uv_handle_t *) &reply_async, nullptr);
+        reply_async_open = false;
+    }
+}
 
-    bool same_lane_clear = true;
-    bool left_lane_clear = lane != 0;
-    bool right_lane_clear = lane != NUM_LANES - 1;
+void Fleet::connect(uWS::WebSocket<uWS::SERVER> ws) {
+    auto connection = make_shared<FleetConnection>(ws);
+    connection->planner.config = config;
+    connection->worker = next_worker;
+    next_worker = (next_worker + 1) % ingest.size();
 
-    for (auto cur_sense : sensor_fusion) {
-        float d = cur_sense[SENSOR_FUSION_IDX.d];
-        double v_x = cur_sense[SENSOR_FUSION_IDX.v_x];
-        double v_y = cur_sense[SENSOR_FUSION_IDX.v_y];
-        double check_speed = sqrt(v_x * v_x + v_y * v_y);
-        double check_car_s = cur_sense[SENSOR_FUSION_IDX.s];
-        check_car_s += (double) prev_size * SIMULATOR_TIME_STEP * check_speed;
+    // The socket keeps its own reference, queued jobs hold theirs until they're done with it
+    ws.setUserData(new shared_ptr<FleetConnection>(connection));
+}
 
-        bool in_same_lane = d < (LANE_WIDTH + LANE_WIDTH * lane) && d > LANE_WIDTH * lane;
-        if (in_same_lane) {
-            bool getting_close = check_car_s > last_s && (check_car_s - last_s) < TARGET_DISTANCE;
-            if (getting_close) {
-                same_lane_clear = false;
-            }
-        } else {
-            // Possible improvement -- these checks will return true if the car is in lane 0,
-            // but the sensed obstacle is in lane 2, thereby preventing the car from going to 1.
-            // I would rather implement FSM than fix this issue as the car performs fairly well otherwise.
-            bool in_left_lane = d < LANE_WIDTH * lane;
-            bool in_right_lane = d > LANE_WIDTH + LANE_WIDTH * lane;
-
-            bool getting_close = check_car_s > last_s - TARGET_DISTANCE / 3
-                                   && check_car_s - last_s < TARGET_DISTANCE;
-            if (in_left_lane) {
-                if (getting_close) {
-                    left_lane_clear = false;
-                }
-            } else {
-                if (!in_right_lane) { // I may need to reconsider this logic? But again, would prefer to use FSM
-                    cout << "in_right_lane must be true if we are here! For car's lane: " << lane << " and sensor's d: " << d << "\n";
-                }
+void Fleet::disconnect(uWS::WebSocket<uWS::SERVER> ws) {
+    auto holder = static_cast<shared_ptr<FleetConnection> *>(ws.getUserData());
+    if (holder) {
+        (*holder)->open = false;
+        delete holder;
+        ws.setUserData(nullptr);
+    }
+}
 
-                if (getting_close) {
-                    right_lane_clear = false;
-                }
-            }
-        }
+bool Fleet::submit(uWS::WebSocket<uWS::SERVER> ws, const json &data) {
+    auto holder = static_cast<shared_ptr<FleetConnection> *>(ws.getUserData());
+    if (!holder) {
+        return false;
     }
 
-    if (same_lane_clear) {
-        if (ref_velocity < MAX_SPEED) {
-            ref_velocity += MAX_SPEED_CHANGE;
-        }
-    } else if (left_lane_clear) {
-        lane--;
-    } else if (right_lane_clear) {
-        lane++;
-    } else {
-        ref_velocity -= MAX_SPEED_CHANGE;
+    try {
+        decode_telemetry(data, ingest_scratch.telemetry);
+    } catch (const exception &e) {
+        return false;
     }
+    if (!valid_telemetry(ingest_scratch.telemetry)) {
+        return false;
+    }
+    ingest_scratch.connection = *holder;
+    ingest_scratch.format = ReplyFormat();
+    return enqueue();
 }
 
-pair<vector<double>, vector<double>> generate_trajectory_for_lane(json data,
-                                                                  Map map,
-                                                                  const int lane,
-                                                                  const double ref_velocity) {
-    // Main car's localization Data
-    double car_x = data["x"];
-    double car_y = data["y"];
-    double car_s = data["s"];
-    double car_yaw = data["yaw"];
-
-    // Previous path data given to the Planner
-    auto previous_path_x = data["previous_path_x"];
-    auto previous_path_y = data["previous_path_y"];
-    // Previous path's end s and d values
-    double end_path_s = data["end_path_s"];
-
-    int prev_size = previous_path_x.size();
-
-    double last_s = prev_size > 0 ? end_path_s : car_s;
-
-    vector<double> pts_x;
-    vector<double> pts_y;
-
-    // ref x,y,yaw states either we will reference the starting point where car is or the previous path end point
-    double ref_x;
-    double ref_y;
-    double ref_yaw;
-
-    // If we're almost empty on paths, use the car as starting reference
-    if (prev_size < 2) {
-        ref_x = car_x;
-        ref_y = car_y;
-        ref_yaw = map.deg2rad(car_yaw);
-        double prev_car_x = car_x - cos(car_yaw);
-        double prev_car_y = car_y - sin(car_yaw);
-
-        pts_x.push_back(prev_car_x);
-        pts_x.push_back(car_x);
-
-        pts_y.push_back(prev_car_y);
-        pts_y.push_back(car_y);
-    } else {
-        ref_x = previous_path_x[prev_size - 1];
-        ref_y = previous_path_y[prev_size - 1];
-
-        double ref_x_prev = previous_path_x[prev_size - 2];
-        double ref_y_prev = previous_path_y[prev_size - 2];
-        ref_yaw = atan2(ref_y - ref_y_prev, ref_x - ref_x_prev);
-
-        pts_x.push_back(ref_x_prev);
-        pts_x.push_back(ref_x);
-
-        pts_y.push_back(ref_y_prev);
-        pts_y.push_back(ref_y);
+bool Fleet::submit(uWS::WebSocket<uWS::SERVER> ws, const char *data, size_t length, uint32_t sequence) {
+    auto holder = static_cast<shared_ptr<FleetConnection> *>(ws.getUserData());
+    if (!holder || !(*holder)->binary) {
+        return false;
     }
 
-    // Add some some extra space for starting reference
-    vector<pair<double, double>> wps;
-    wps.push_back(map.getXY(last_s + TARGET_DISTANCE    , (HALF_LANE_WIDTH + LANE_WIDTH * lane)));
-    wps.push_back(map.getXY(last_s + TARGET_DISTANCE * 2, (HALF_LANE_WIDTH + LANE_WIDTH * lane)));
-    wps.push_back(map.getXY(last_s + TARGET_DISTANCE * 3, (HALF_LANE_WIDTH + LANE_WIDTH * lane)));
-    for (pair<double, double> wp : wps) {
-        pts_x.push_back(wp.first);
-        pts_y.push_back(wp.second);
+    uint8_t flags = (*holder)->binary_flags;
+    if (!read_binary_telemetry(data, length, flags, ingest_scratch.telemetry)
+        || !valid_telemetry(ingest_scratch.telemetry)) {
+        return false;
     }
 
-    // Transform to local car coordinates
-    for (int i = 0; i < pts_x.size(); ++i) {
-        double shift_x = pts_x[i] - ref_x;
-        double shift_y = pts_y[i] - ref_y;
+    ingest_scratch.connection = *holder;
+    ingest_scratch.format.binary = true;
+    ingest_scratch.format.flags = flags;
+    ingest_scratch.format.sequence = sequence;
+    return enqueue();
+}
 
-        pts_x[i] = shift_x * cos(0 - ref_yaw) - shift_y * sin(0 - ref_yaw);
-        pts_y[i] = shift_x * sin(0 - ref_yaw) + shift_y * cos(0 - ref_yaw);
-    }
+bool Fleet::enqueue() {
+    bool queued = ingest[ingest_scratch.connection->worker]->try_push(ingest_scratch);
+    ingest_scratch.connection.reset();
+    return queued;
+}
 
-    tk::spline spline;
-    spline.set_points(pts_x, pts_y);
+void Fleet::hello(uWS::WebSocket<uWS::SERVER> ws, uint8_t flags) {
+    auto holder = static_cast<shared_ptr<FleetConnection> *>(ws.getUserData());
+    if (!holder) {
+        return;
+    }
 
-    vector<double> next_x_vals;
-    vector<double> next_y_vals;
+    (*holder)->binary = true;
+    (*holder)->binary_flags = flags;
+    write_binary_hello(hello_frame, BINARY_HELLO_ACK, flags);
+    sendMessage(ws, hello_frame, uWS::OpCode::BINARY);
+}
 
-    // Add all previous paths to next
-    next_x_vals.insert(end(next_x_vals), begin(previous_path_x), end(previous_path_x));
-    next_y_vals.insert(end(next_y_vals), begin(previous_path_y), end(previous_path_y));
+void Fleet::work(int worker) {
+    IngestQueue &queue = *ingest[worker];
+    TelemetryJob job;
+    ReplyJob reply;
+    int idle = 0;
+
+    while (running) {
+        if (!queue.try_pop(job)) {
+            // Back off gradually so an idle worker doesn't hog a core
+            if (++idle < 64) {
+                this_thread::yield();
+            } else {
+                this_thread::sleep_for(chrono::microseconds(200));
+            }
+            continue;
+        }
+        idle = 0;
 
-    double target_x = TARGET_DISTANCE;
-    double target_y = spline(target_x);
-    double target_dist = sqrt(target_x * target_x + target_y * target_y);
+        process_telemetry_data(*maps.get(), job.telemetry, job.connection->planner, job.format, reply.frame);
+        reply.connection = job.connection;
+        reply.binary = job.format.binary;
+        job.connection.reset();
 
-    double x_add_on = 0;
+        // If the websocket thread can't keep up, hold on here, which backs up our ingest queue in turn
+        while (!replies.try_push(reply) && running) {
+            this_thread::yield();
+        }
+        reply.connection.reset();
 
-    int points_to_add = NUM_POINTS - prev_size;
-    for (int i = 1; i <= points_to_add; i++) {
-        double N = target_dist / (SIMULATOR_TIME_STEP * ref_velocity / MPH_TO_METERS); // converting back to meters/s, not MPH
-        double x_point = x_add_on + target_x / N;
-        double y_point = spline(x_point);
+        uv_async_send(&reply_async);
+    }
+}
 
-        x_add_on = x_point;
+void Fleet::send_replies() {
+    // Take everything that's ready in one go, swapping frames out of the queue into our own buffers
+    size_t count = 0;
+    for (;;) {
+        if (count == ready.size()) {
+            ready.emplace_back();
+        }
+        if (!replies.try_pop(ready[count])) {
+            break;
+        }
+        count++;
+    }
 
-        double local_x_ref = x_point;
-        double local_y_ref = y_point;
+    // A car that got ahead of us has several replies waiting, each path replaces the previous one
+    // in the simulator, so only the newest is worth sending.
+    send_round++;
+    for (size_t i = count; i-- > 0;) {
+        FleetConnection &connection = *ready[i].connection;
+        if (connection.open && connection.last_send_round != send_round) {
+            connection.last_send_round = send_round;
+            sendMessage(connection.ws, ready[i].frame, ready[i].binary ? uWS::OpCode::BINARY : uWS::OpCode::TEXT);
+            if (++replies_sent % FLEET_STATS_INTERVAL == 0) {
+                print_stats();
+            }
+        } else if (connection.open) {
+            replies_superseded++;
+        }
+        ready[i].connection.reset();
+    }
+}
 
-        // rotate back to normal after rotating it earlier
-        x_point = local_x_ref * cos(ref_yaw) - local_y_ref * sin(ref_yaw);
-        y_point = local_x_ref * sin(ref_yaw) + local_y_ref * cos(ref_yaw);
+void Fleet::print_stats() {
+    QueueStats reply_stats = replies.stats();
+    cout << "Fleet: " << replies_sent << " replies sent, " << replies_superseded << " superseded by a newer one, "
+         << "reply queue high water " << reply_stats.high_water << "\n";
+    for (int i = 0; i < (int) ingest.size(); i++) {
+        QueueStats stats = ingest[i]->stats();
+        cout << "  worker " << i << ": " << stats.popped << " planned, " << stats.rejected << " dropped, "
+             << ingest[i]->size() << " queued (high water " << stats.high_water << ")\n";
+    }
+    if (allocation_tracking_enabled()) {
+        AllocationStats stages[NUM_ALLOCATION_STAGES];
+        stages[STAGE_DECODE] = decode_allocations;
+        cout << "  websocket thread ";
+        print_allocation_stats(cout, stages);
+    }
+}
 
 
-        // Very poor naming from Q&A, x_ref looks a lot like ref_x, was stuck on that for a little!
-        x_point += ref_x;
-        y_point += ref_y;
+void process_telemetry_data(const Map &map,
+                            const Telemetry &telemetry,
+                            PlannerState &state,
+                            const ReplyFormat &format,
+                            string &frame) {
+    const pair<vector<double>, vector<double>> &trajectory = plan_path(map, telemetry, state);
 
-        next_x_vals.push_back(x_point);
-        next_y_vals.push_back(y_point);
+    AllocationScope scope(state.allocations[STAGE_ENCODE]);
+    if (format.binary) {
+        size_t kept = count_kept_points(trajectory.first, trajectory.second,
+                                        telemetry.previous_path_x, telemetry.previous_path_y);
+        write_binary_control(frame, trajectory.first, trajectory.second, format.flags, format.sequence, kept);
+    } else {
+        write_control_frame(frame, trajectory.first, trajectory.second);
     }
-
-    return make_pair(next_x_vals, next_y_vals);
 }
@@ -0,0 +1,20 @@
+//
+// Minimal checks for the unit tests, which are plain executables run by ctest. Unlike assert these stay
+// on in every build type, and a failure says where and what before the test exits non-zero.
+//
+
+#ifndef PATH_PLANNING_CHECK_H
+#define PATH_PLANNING_CHECK_H
+
+#include <cstdlib>
+#include <iostream>
+
+#define CHECK(condition)                                                                            \
+    do {                                                                                            \
+        if (!(condition)) {                                                                         \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1);                                                                           \
+        }                                                                                           \
+    } while (0)
+
+#endif //PATH_PLANNING_CHECK_H
@@ -0,0 +1,30 @@
+//
+// Command line overrides: a shorter --points doesn't need a matching --min-points.
+//
+
+#include "Check.h"
+#include "../src/Config.h"
+
+static bool parse(vector<const char *> args, Config &config) {
+    args.insert(args.begin(), "path_planning");
+    return parse_config_args((int) args.size(), const_cast<char **>(args.data()), config);
+}
+
+int main() {
+    Config config;
+    CHECK(parse({"--points", "20"}, config));
+    CHECK(config.planner.num_points == 20);
+    CHECK(config.planner.min_points == 20);
+
+    Config longer;
+    CHECK(parse({"--points", "80"}, longer));
+    CHECK(longer.planner.min_points == MIN_POINTS);
+
+    Config both;
+    CHECK(parse({"--points", "20", "--min-points", "10"}, both));
+    CHECK(both.planner.min_points == 10);
+
+    Config conflicting;
+    CHECK(!parse({"--points", "20", "--min-points", "30"}, conflicting));
+    return 0;
+}
@@ -0,0 +1,59 @@
+//
+// CubicSpline has to give exactly what tk::spline gave the planner before it, to the bit, inside the anchors
+// and extrapolating either side of them, natural or with the slope given at the start. Its derivatives have to
+// agree with finite differences of it.
+//
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include <spline.h>
+#include "Check.h"
+#include "../src/CubicSpline.h"
+
+using namespace std;
+
+int main() {
+    mt19937 rng(1);
+    uniform_real_distribution<double> random_gap(.1, 60), random_y(-20, 20);
+
+    for (int fit = 0; fit < 1000; fit++) {
+        int n = 3 + fit % 3;
+        vector<double> x(n), y(n);
+        x[0] = -random_gap(rng);
+        for (int i = 0; i < n; i++) {
+            x[i] = i == 0 ? x[0] : x[i - 1] + random_gap(rng);
+            y[i] = random_y(rng);
+        }
+
+        bool clamped = fit % 2 == 1;
+        double left_slope = random_y(rng) / 10;
+
+        tk::spline expected;
+        CubicSpline<5> spline;
+        if (clamped) {
+            expected.set_boundary(tk::spline::first_deriv, left_slope, tk::spline::second_deriv, 0, false);
+            spline.set_points(x.data(), y.data(), n, left_slope);
+        } else {
+            spline.set_points(x.data(), y.data(), n);
+        }
+        expected.set_points(x, y);
+        if (clamped) {
+            CHECK(fabs(spline.derivative(x[0]) - left_slope) < 1e-9);
+        }
+
+        for (double at = x[0] - 10; at < x[n - 1] + 10; at += .37) {
+            CHECK(spline(at) == expected(at));
+
+            double h = 1e-4;
+            double slope = (spline(at + h) - spline(at - h)) / (2 * h);
+            double bend = (spline(at + h) - 2 * spline(at) + spline(at - h)) / (h * h);
+            CHECK(fabs(spline.derivative(at) - slope) < 1e-6 * (1 + fabs(slope)));
+            CHECK(fabs(spline.second_derivative(at) - bend) < 1e-3 * (1 + fabs(bend)));
+        }
+        for (int i = 0; i < n; i++) {
+            CHECK(spline(x[i]) == expected(x[i]));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+//
+// HorizonController against a client that drives some of every path before the next message: the horizon
+// follows how much it drives and how long planning takes, grows when either does and comes back down after.
+//
+
+#include <algorithm>
+#include "Check.h"
+#include "../src/Horizon.h"
+#include "../src/PathPlanner.h"
+
+struct Client {
+    HorizonController controller;
+    PlannerConfig config;
+    int left = 0; // points of the last path not driven yet
+
+    // One message: the client drives some points, we plan for plan_seconds and send a path back
+    int message(int driven, double plan_seconds) {
+        left = max(0, left - driven);
+        controller.observe(left);
+        int points = controller.horizon(config);
+        controller.sent_path(points, plan_seconds, config);
+        left = points;
+        return points;
+    }
+};
+
+int main() {
+    Client client;
+    client.config.min_points = 10;
+
+    // Nothing driven yet, so the longest path
+    CHECK(client.message(0, .001) == client.config.num_points);
+
+    // 5 points a message and quick planning settle just above twice that
+    int settled = 0;
+    for (int i = 0; i < 1000; i++) {
+        settled = client.message(5, .001);
+    }
+    CHECK(settled == 11);
+
+    // Twice the driving grows it right away, and once a planning tick has been slow, even more
+    int grown = client.message(10, .2);
+    CHECK(grown == 21);
+    int slow = client.message(10, .001);
+    CHECK(slow == 30);
+
+    // Back to 5 points and quick planning, the peaks decay and the horizon shrinks back
+    int shrunk = slow;
+    for (int i = 0; i < 1000; i++) {
+        int points = client.message(5, .001);
+        CHECK(points <= shrunk);
+        shrunk = points;
+    }
+    CHECK(shrunk == settled);
+
+    const HorizonStats &stats = client.controller.stats;
+    CHECK(stats.starved == 0);
+    CHECK(stats.max_driven == 10);
+    CHECK(stats.min_horizon == 11 && stats.max_horizon == client.config.num_points);
+    return 0;
+}
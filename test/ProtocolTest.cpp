@@ -0,0 +1,56 @@
+//
+// hasData's nesting limit, which brackets inside strings mustn't get around, and decoding a sensor fusion
+// id that doesn't fit an int.
+//
+
+#include <exception>
+#include <string>
+#include "Check.h"
+#include "../src/Protocol.h"
+#include "../src/Telemetry.h"
+
+using namespace std;
+
+static string nested(int depth) {
+    return string(depth, '[') + string(depth, ']');
+}
+
+static string frame(const string &message) {
+    return "42[\"telemetry\"," + message + "]";
+}
+
+static bool accepted(const string &s) {
+    return !hasData(s.data(), s.size()).empty();
+}
+
+int main() {
+    CHECK(accepted(frame(nested(SOCKETIO_MAX_DEPTH - 1))));
+    CHECK(!accepted(frame(nested(SOCKETIO_MAX_DEPTH))));
+
+    // Closing brackets in a string don't make room for deeper nesting after it, escaped quote or not
+    string closing(200, ']');
+    CHECK(accepted(frame("\"" + closing + "\"")));
+    CHECK(!accepted(frame("\"" + closing + "\"," + nested(150))));
+    CHECK(!accepted(frame("\"\\\"" + closing + "\"," + nested(150))));
+    CHECK(accepted(frame("\"" + string(200, '[') + "\"")));
+
+    // Nor do stray closing brackets outside of strings
+    CHECK(!accepted(frame(closing + nested(150))));
+
+    json data = json::parse("{\"x\":0,\"y\":0,\"yaw\":0,\"speed\":0,\"s\":0,\"d\":0,\"previous_path_x\":[],"
+                            "\"previous_path_y\":[],\"end_path_s\":0,\"end_path_d\":0,"
+                            "\"sensor_fusion\":[[7,1,2,3,4,5,6]]}");
+    Telemetry telemetry;
+    decode_telemetry(data, telemetry);
+    CHECK(telemetry.sensor_fusion.size() == 1 && telemetry.sensor_fusion[0].id == 7);
+
+    data["sensor_fusion"][0][0] = 1e300;
+    bool thrown = false;
+    try {
+        decode_telemetry(data, telemetry);
+    } catch (const exception &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    return 0;
+}
@@ -0,0 +1,60 @@
+//
+// TelemetryQueue under several producers and consumers at once: nothing lost or duplicated, and the
+// counters stay within what the queue can hold.
+//
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Check.h"
+#include "../src/TelemetryQueue.h"
+
+static const size_t CAPACITY = 4; // small, so consumers often catch up with a producer mid-push
+static const int THREADS = 4; // of each kind
+static const int PER_PRODUCER = 200000;
+
+int main() {
+    TelemetryQueue<int, CAPACITY> queue;
+    atomic<long long> sum(0);
+    atomic<int> consumed(0);
+    vector<thread> threads;
+
+    for (int p = 0; p < THREADS; p++) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 1; i <= PER_PRODUCER; i++) {
+                int value = p * PER_PRODUCER + i;
+                while (!queue.try_push(value)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < THREADS; c++) {
+        threads.emplace_back([&queue, &sum, &consumed]() {
+            int value = 0;
+            while (consumed.load() < THREADS * PER_PRODUCER) {
+                if (queue.try_pop(value)) {
+                    sum += value;
+                    consumed++;
+                } else {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+
+    long long n = (long long) THREADS * PER_PRODUCER;
+    CHECK(consumed.load() == n);
+    CHECK(sum.load() == n * (n + 1) / 2);
+    CHECK(queue.size() == 0);
+
+    QueueStats stats = queue.stats();
+    CHECK(stats.pushed == (uint64_t) n);
+    CHECK(stats.popped == (uint64_t) n);
+    CHECK(stats.high_water >= 1);
+    CHECK(stats.high_water <= CAPACITY);
+    return 0;
+}
@@ -0,0 +1,75 @@
+//
+// VehicleGrid's queries against a scan of every car, both with too few cars to hash and with enough.
+//
+
+#include <math.h>
+#include <random>
+#include "Check.h"
+#include "../src/VehicleGrid.h"
+
+static const double TRACK_LENGTH = 6945.554;
+static const int NUM_LANES = 3;
+
+static void check_queries(int num_vehicles, mt19937 &rng) {
+    uniform_real_distribution<double> random_s(-50, TRACK_LENGTH + 50), random_speed(0, 50);
+    uniform_int_distribution<int> random_lane(-1, NUM_LANES);
+
+    VehicleGrid grid;
+    vector<GridVehicle> all;
+    grid.begin(TRACK_LENGTH, NUM_LANES);
+    for (int id = 0; id < num_vehicles; id++) {
+        GridVehicle vehicle = {id, random_lane(rng), random_s(rng), 0, random_speed(rng)};
+        grid.add(vehicle.id, vehicle.lane, vehicle.s, vehicle.d, vehicle.speed);
+        all.push_back(vehicle);
+    }
+    grid.build();
+    CHECK((int) grid.size() == num_vehicles);
+
+    vector<GridNeighbor> ahead, behind;
+    for (int query = 0; query < 200; query++) {
+        int lane = random_lane(rng);
+        double s = random_s(rng);
+        double distance = uniform_real_distribution<double>(1, 300)(rng);
+
+        int in_window = 0, within_ahead = 0, within_behind = 0;
+        double nearest_gap = distance;
+        for (const GridVehicle &vehicle : all) {
+            if (vehicle.lane != lane) {
+                continue;
+            }
+            double gap_ahead = wrap_s(vehicle.s - s, TRACK_LENGTH);
+            double gap_behind = wrap_s(s - vehicle.s, TRACK_LENGTH);
+            in_window += s_in_window(vehicle.s, s, distance, TRACK_LENGTH);
+            within_ahead += gap_ahead < distance;
+            within_behind += gap_behind > 0 && gap_behind < distance;
+            nearest_gap = min(nearest_gap, gap_ahead);
+        }
+
+        int seen = 0;
+        grid.any_in_window(lane, s, distance, [&](const GridVehicle &vehicle) {
+            seen++;
+            return false;
+        });
+        CHECK(seen == in_window);
+        CHECK(grid.any_in_window(lane, s, distance, [](const GridVehicle &) { return true; }) == (in_window > 0));
+
+        GridNeighbor nearest;
+        CHECK(grid.nearest_ahead(lane, s, distance, nearest) == (within_ahead > 0));
+        CHECK(within_ahead == 0 || fabs(nearest.gap - nearest_gap) < 1e-9);
+
+        grid.nearest_ahead(lane, s, distance, 2, ahead);
+        CHECK((int) ahead.size() == min(2, within_ahead));
+        CHECK(ahead.empty() || fabs(ahead[0].gap - nearest_gap) < 1e-9);
+        grid.nearest_behind(lane, s, distance, 2, behind);
+        CHECK((int) behind.size() == min(2, within_behind));
+        CHECK(behind.size() < 2 || behind[0].gap <= behind[1].gap);
+    }
+}
+
+int main() {
+    mt19937 rng(1);
+    for (int num_vehicles : {0, 1, 12, GRID_MIN_HASHED_VEHICLES - 1, GRID_MIN_HASHED_VEHICLES, 500}) {
+        check_queries(num_vehicles, rng);
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+//
+// VehicleTracker keeps every live vehicle's own track, whatever its id.
+//
+
+#include <math.h>
+#include "Check.h"
+#include "../src/VehicleTracker.h"
+
+static const double DT = .02;
+
+// Vehicles driving at constant speeds, each seen every tick
+static void drive(VehicleTracker &tracker, const int *ids, int count, int ticks) {
+    for (int t = 0; t < ticks; t++) {
+        tracker.begin_tick(DT);
+        for (int i = 0; i < count; i++) {
+            double speed = 10 + ids[i] % 7; // differs between the ids each test uses
+            tracker.observe(ids[i], 100 + speed * t * DT, 6, speed, 0);
+        }
+    }
+}
+
+// Ids that all landed in the same slot when tracks were indexed by id modulo the table size
+static void colliding_ids() {
+    VehicleTracker tracker;
+    const int ids[] = {3, 3 + MAX_TRACKED_VEHICLES, 3 + 2 * MAX_TRACKED_VEHICLES, 3 - MAX_TRACKED_VEHICLES};
+    drive(tracker, ids, 4, 20);
+
+    for (int id : ids) {
+        const VehicleTrack *track = tracker.find(id);
+        CHECK(track != nullptr);
+        CHECK(track->id == id);
+        CHECK(track->count == TRACK_HISTORY);
+        CHECK(fabs(track->speed - (10 + id % 7)) < 1e-9);
+        CHECK(fabs(track->accel) < 1e-9);
+    }
+}
+
+// As many vehicles as there are slots, all of them live
+static void full_table() {
+    VehicleTracker tracker;
+    int ids[MAX_TRACKED_VEHICLES];
+    for (int i = 0; i < MAX_TRACKED_VEHICLES; i++) {
+        ids[i] = i * 1000 + 7;
+    }
+    drive(tracker, ids, MAX_TRACKED_VEHICLES, 10);
+
+    for (int id : ids) {
+        const VehicleTrack *track = tracker.find(id);
+        CHECK(track != nullptr);
+        CHECK(track->id == id);
+        CHECK(track->count == TRACK_HISTORY);
+    }
+}
+
+// Vehicles that left sensor range give their slots up to new ones, without losing the ones still around
+static void stale_eviction() {
+    VehicleTracker tracker;
+    int gone[MAX_TRACKED_VEHICLES];
+    for (int i = 0; i < MAX_TRACKED_VEHICLES; i++) {
+        gone[i] = i;
+    }
+    drive(tracker, gone, MAX_TRACKED_VEHICLES, 3);
+
+    const int staying[] = {5, 9};
+    drive(tracker, staying, 2, TRACK_STALE_TICKS + 1);
+    CHECK(tracker.find(0) == nullptr);
+    CHECK(tracker.find(5) != nullptr);
+
+    // The two still around and enough new ones to need every other slot
+    int now[MAX_TRACKED_VEHICLES] = {5, 9};
+    for (int i = 2; i < MAX_TRACKED_VEHICLES; i++) {
+        now[i] = 500 + i;
+    }
+    drive(tracker, now, MAX_TRACKED_VEHICLES, 5);
+
+    for (int id : staying) {
+        const VehicleTrack *track = tracker.find(id);
+        CHECK(track != nullptr);
+        CHECK(track->id == id);
+        CHECK(track->count == TRACK_HISTORY);
+    }
+    for (int id : now) {
+        const VehicleTrack *track = tracker.find(id);
+        CHECK(track != nullptr);
+        CHECK(track->id == id);
+    }
+    CHECK(tracker.find(0) == nullptr);
+}
+
+int main() {
+    colliding_ids();
+    full_table();
+    stale_eviction();
+    return 0;
+}